@@ -0,0 +1,129 @@
+﻿#ifndef _FM_SDK_CANCELLATION_TOKEN_H_
+#define _FM_SDK_CANCELLATION_TOKEN_H_
+
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include "SystemExport.h"
+#include "Exception.h"
+
+namespace fm {
+
+namespace detail {
+
+// 取消源与其令牌共享的取消标志
+struct CancellationState
+{
+	CancellationState() : cancelled(false) { }
+
+	boost::atomic<bool> cancelled;
+};
+
+}
+
+/**
+ * @brief 取消令牌。
+ *
+ * 取消令牌由 CancellationSource::GetToken() 获取，可以随任务一起传递和复制。正在执行的任务
+ * 通过 IsCancellationRequested() 轮询取消请求，每次检查只有一次原子读取；提交到线程池时指定
+ * 令牌的任务，在令牌被取消后如果仍在队列中则直接丢弃，不再执行。
+ * @note 缺省构造的令牌永远不会被取消。
+ */
+class CancellationToken
+{
+public:
+	/**
+	 * @brief 缺省构造函数，创建永远不会被取消的令牌。
+	 */
+	CancellationToken() { }
+
+	/**
+	 * @brief 判断是否已请求取消。
+	 */
+	bool IsCancellationRequested() const
+	{
+		return m_state && m_state->cancelled.load(boost::memory_order_acquire);
+	}
+
+	/**
+	 * @brief 已请求取消时抛出 OperationCanceledException。
+	 */
+	void ThrowIfCancellationRequested() const
+	{
+		if (IsCancellationRequested())
+			throw OperationCanceledException("The operation was cancelled.");
+	}
+
+	/**
+	 * @brief 判断令牌是否可能被取消，缺省构造的令牌返回 false。
+	 */
+	bool CanBeCancelled() const
+	{
+		return m_state.get() != NULL;
+	}
+
+	/**
+	 * @brief 交换两个令牌。
+	 */
+	void swap(CancellationToken& other)
+	{
+		m_state.swap(other.m_state);
+	}
+
+private:
+	friend class CancellationSource;
+
+	explicit CancellationToken(const boost::shared_ptr<detail::CancellationState>& state) : m_state(state) { }
+
+	boost::shared_ptr<detail::CancellationState> m_state;
+};
+
+/**
+ * @brief 取消源。
+ *
+ * 调用 Cancel() 后，由该取消源获取的所有令牌都处于已取消状态。取消是单向的，不能撤销。
+ * @note 使用示例：
+ * -     CancellationSource source;
+ * -     pool->PushTask(task, source.GetToken());
+ * -     ...
+ * -     source.Cancel();    // 尚未执行的 task 被丢弃，正在执行的 task 可检查令牌后提前结束
+ */
+class CancellationSource
+{
+public:
+	/**
+	 * @brief 构造函数。
+	 */
+	CancellationSource() : m_state(boost::make_shared<detail::CancellationState>()) { }
+
+	/**
+	 * @brief 请求取消，可以重复调用。
+	 */
+	void Cancel()
+	{
+		m_state->cancelled.store(true, boost::memory_order_release);
+	}
+
+	/**
+	 * @brief 判断是否已请求取消。
+	 */
+	bool IsCancellationRequested() const
+	{
+		return m_state->cancelled.load(boost::memory_order_acquire);
+	}
+
+	/**
+	 * @brief 获取与本取消源关联的令牌。
+	 */
+	CancellationToken GetToken() const
+	{
+		return CancellationToken(m_state);
+	}
+
+private:
+	boost::shared_ptr<detail::CancellationState> m_state;
+};
+
+}
+
+#endif
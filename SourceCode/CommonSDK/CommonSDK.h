@@ -14,7 +14,17 @@
 #include "ExecutionContext.h"
 #include "XmlConfig.h"
 #include "StringUtil.h"
+#include "TaskAllocator.h"
 #include "ThreadTask.h"
+#include "Future.h"
+#include "CancellationToken.h"
 #include "ThreadPool.h"
+#include "LockFreeQueue.h"
+#include "ParallelAlgorithm.h"
+#include "TaskGraph.h"
+#include "TimerService.h"
+#include "Strand.h"
+#include "TaskGroup.h"
+#include "Coroutine.h"
 
 #endif
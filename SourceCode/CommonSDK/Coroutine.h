@@ -0,0 +1,631 @@
+﻿#ifndef _FM_SDK_COROUTINE_H_
+#define _FM_SDK_COROUTINE_H_
+
+#if defined(__cpp_impl_coroutine) || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#define FM_HAS_COROUTINE 1
+#endif
+
+#ifdef FM_HAS_COROUTINE
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "SystemExport.h"
+#include "TaskAllocator.h"
+#include "ThreadTask.h"
+#include "ThreadPool.h"
+#include "TimerService.h"
+
+namespace fm {
+
+template<typename T>
+class task;
+
+namespace detail {
+
+// 恢复协程的线程任务。任务对象嵌入在挂起协程的帧中，通过不持有所有权的 ThreadTaskPtr
+// 提交到线程池，调度过程中没有任何内存分配
+class CoroutineResumeTask : public ThreadTask
+{
+public:
+	CoroutineResumeTask() : cancelled(false) { }
+
+	void Execute()
+	{
+		// 恢复后协程可能立即结束并释放本对象，之后不能再访问成员
+		handle.resume();
+	}
+
+	// 线程池丢弃任务时标记为已取消后恢复协程，等待对象的 await_resume() 抛出
+	// OperationCanceledException，协程只在丢弃任务的线程中展开到最近的异常处理，
+	// 不会像正常调度一样继续执行 co_await 之后的代码；等待它的协程和线程也不会永远挂起
+	void Cancel()
+	{
+		cancelled = true;
+		handle.resume();
+	}
+
+	// 在等待对象的 await_resume() 中调用
+	void ThrowIfCancelled() const
+	{
+		if (cancelled)
+			throw OperationCanceledException("Coroutine was cancelled before it resumed.");
+	}
+
+	ThreadTaskPtr Ptr()
+	{
+		return ThreadTaskPtr(ThreadTaskPtr(), this);
+	}
+
+	std::coroutine_handle<> handle;
+
+	bool cancelled;
+};
+
+class task_promise_base
+{
+public:
+	struct final_awaiter
+	{
+		bool await_ready() const noexcept { return false; }
+
+		template<typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+		{
+			std::coroutine_handle<> continuation = handle.promise().continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+
+		void await_resume() noexcept { }
+	};
+
+	std::suspend_always initial_suspend() noexcept { return {}; }
+
+	final_awaiter final_suspend() noexcept { return {}; }
+
+	void unhandled_exception() noexcept
+	{
+		exception = std::current_exception();
+	}
+
+	static void* operator new(size_t size)
+	{
+		return TaskMemory::Allocate(size);
+	}
+
+	static void operator delete(void* ptr, size_t size)
+	{
+		TaskMemory::Deallocate(ptr, size);
+	}
+
+	std::coroutine_handle<> continuation;
+
+	std::exception_ptr exception;
+};
+
+template<typename T>
+class task_promise : public task_promise_base
+{
+public:
+	task<T> get_return_object() noexcept;
+
+	template<typename U>
+	void return_value(U&& value)
+	{
+		result.emplace(std::forward<U>(value));
+	}
+
+	T& get()
+	{
+		if (exception)
+			std::rethrow_exception(exception);
+		return *result;
+	}
+
+private:
+	std::optional<T> result;
+};
+
+template<>
+class task_promise<void> : public task_promise_base
+{
+public:
+	task<void> get_return_object() noexcept;
+
+	void return_void() noexcept { }
+
+	void get()
+	{
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+};
+
+}
+
+/**
+ * @brief 协程任务。
+ *
+ * task<T> 是惰性启动的协程：创建后不会执行，直到被 co_await 或交给 sync_wait。
+ * 协程结束时通过对称转移直接恢复等待者，不经过线程池。协程帧由 TaskMemory 分配，在其它线程中释放的帧也能循环复用。
+ * @note 使用示例：
+ * -     task<int> Load(ThreadPoolPtr pool)
+ * -     {
+ * -         co_await schedule(pool);   // 之后在线程池的工作线程中执行
+ * -         co_await delay(100);
+ * -         co_return 42;
+ * -     }
+ * -     int value = sync_wait(Load(pool));
+ */
+template<typename T = void>
+class task
+{
+public:
+	typedef detail::task_promise<T> promise_type;
+
+	task() noexcept { }
+
+	explicit task(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) { }
+
+	task(task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) { }
+
+	task& operator=(task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_handle)
+				m_handle.destroy();
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+
+	task(const task&) = delete;
+	task& operator=(const task&) = delete;
+
+	~task()
+	{
+		if (m_handle)
+			m_handle.destroy();
+	}
+
+	/**
+	 * @brief 判断协程是否已经执行结束。
+	 */
+	bool is_ready() const noexcept
+	{
+		return !m_handle || m_handle.done();
+	}
+
+	/**
+	 * @brief 等待协程结束并获取结果，协程抛出的异常在此重新抛出。
+	 */
+	auto operator co_await() noexcept
+	{
+		struct awaiter : ready_awaiter
+		{
+			decltype(auto) await_resume()
+			{
+				return this->handle.promise().get();
+			}
+		};
+		return awaiter{ { m_handle } };
+	}
+
+	/**
+	 * @brief 等待协程结束但不获取结果，也不重新抛出异常。
+	 */
+	auto when_ready() noexcept
+	{
+		return ready_awaiter{ m_handle };
+	}
+
+	/**
+	 * @brief 获取结果，只能在协程结束后调用。
+	 */
+	decltype(auto) result()
+	{
+		return m_handle.promise().get();
+	}
+
+private:
+	struct ready_awaiter
+	{
+		bool await_ready() const noexcept
+		{
+			return !handle || handle.done();
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			handle.promise().continuation = awaiting;
+			return handle;
+		}
+
+		void await_resume() noexcept { }
+
+		std::coroutine_handle<promise_type> handle;
+	};
+
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+namespace detail {
+
+template<typename T>
+task<T> task_promise<T>::get_return_object() noexcept
+{
+	return task<T>(std::coroutine_handle<task_promise<T> >::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object() noexcept
+{
+	return task<void>(std::coroutine_handle<task_promise<void> >::from_promise(*this));
+}
+
+// 子协程结束时的通知对象
+class completion_signal
+{
+public:
+	virtual void notify() noexcept = 0;
+
+protected:
+	~completion_signal() { }
+};
+
+// 等待一个 task 结束并发出通知的内部协程，用于 when_all 和 sync_wait
+class notify_task
+{
+public:
+	struct promise_type
+	{
+		struct final_awaiter
+		{
+			bool await_ready() const noexcept { return false; }
+
+			void await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+			{
+				handle.promise().signal->notify();
+			}
+
+			void await_resume() noexcept { }
+		};
+
+		notify_task get_return_object() noexcept
+		{
+			return notify_task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+
+		final_awaiter final_suspend() noexcept { return {}; }
+
+		void return_void() noexcept { }
+
+		void unhandled_exception() noexcept
+		{
+			std::terminate();
+		}
+
+		static void* operator new(size_t size)
+		{
+			return TaskMemory::Allocate(size);
+		}
+
+		static void operator delete(void* ptr, size_t size)
+		{
+			TaskMemory::Deallocate(ptr, size);
+		}
+
+		completion_signal* signal = nullptr;
+	};
+
+	explicit notify_task(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) { }
+
+	notify_task(notify_task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) { }
+
+	notify_task(const notify_task&) = delete;
+	notify_task& operator=(const notify_task&) = delete;
+
+	~notify_task()
+	{
+		if (m_handle)
+			m_handle.destroy();
+	}
+
+	void start(completion_signal& signal)
+	{
+		m_handle.promise().signal = &signal;
+		m_handle.resume();
+	}
+
+private:
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+template<typename T>
+notify_task make_notify_task(task<T>& t)
+{
+	co_await t.when_ready();
+}
+
+// when_all 的计数器：计数初始为子协程数加一，等待者和每个子协程各减一，减到零的一方恢复等待者
+class when_all_latch : public completion_signal
+{
+public:
+	explicit when_all_latch(size_t count) : m_count(count + 1) { }
+
+	bool await_ready() const noexcept
+	{
+		return m_count.load(std::memory_order_acquire) == 1;
+	}
+
+	bool await_suspend(std::coroutine_handle<> awaiting) noexcept
+	{
+		m_awaiting = awaiting;
+		return m_count.fetch_sub(1, std::memory_order_acq_rel) > 1;
+	}
+
+	void await_resume() noexcept { }
+
+	void notify() noexcept
+	{
+		if (m_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			m_awaiting.resume();
+	}
+
+private:
+	std::atomic<size_t> m_count;
+
+	std::coroutine_handle<> m_awaiting;
+};
+
+// sync_wait 的完成事件
+class sync_wait_event : public completion_signal
+{
+public:
+	void notify() noexcept
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		m_done = true;
+		m_condition.notify_all();
+	}
+
+	void wait()
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		while (!m_done)
+			m_condition.wait(lock);
+	}
+
+private:
+	boost::mutex m_mutex;
+
+	boost::condition_variable m_condition;
+
+	bool m_done = false;
+};
+
+// when_all 结果中代替 void 的占位类型
+struct void_result { };
+
+template<typename T>
+struct when_all_result
+{
+	typedef T type;
+
+	static T get(task<T>& t)
+	{
+		return std::move(t.result());
+	}
+};
+
+template<>
+struct when_all_result<void>
+{
+	typedef void_result type;
+
+	static void_result get(task<void>& t)
+	{
+		t.result();
+		return void_result();
+	}
+};
+
+}
+
+/**
+ * @brief 切换到线程池中执行的等待对象。
+ */
+class schedule_awaiter
+{
+public:
+	explicit schedule_awaiter(ThreadPoolPtr pool) : m_pool(pool) { }
+
+	bool await_ready() const noexcept { return false; }
+
+	bool await_suspend(std::coroutine_handle<> awaiting)
+	{
+		m_resume.handle = awaiting;
+
+		// 有界线程池拒绝任务时不挂起，继续在当前线程中执行
+		return m_pool->PushTask(m_resume.Ptr()) != TASK_PUSH_FULL;
+	}
+
+	void await_resume() const
+	{
+		m_resume.ThrowIfCancelled();
+	}
+
+private:
+	ThreadPoolPtr m_pool;
+
+	detail::CoroutineResumeTask m_resume;
+};
+
+/**
+ * @brief 将当前协程切换到线程池中继续执行。
+ *
+ * @param pool 线程池，co_await 之后的代码在该线程池的工作线程中执行。
+ * @note 线程池终止等原因丢弃了恢复任务时 co_await 抛出 OperationCanceledException。
+ */
+inline schedule_awaiter schedule(ThreadPoolPtr pool)
+{
+	return schedule_awaiter(pool);
+}
+
+/**
+ * @brief 延迟等待对象。
+ */
+class delay_awaiter
+{
+public:
+	delay_awaiter(TimerServicePtr timer, long long delay_ms) : m_timer(timer), m_delay(delay_ms) { }
+
+	bool await_ready() const noexcept { return m_delay <= 0; }
+
+	void await_suspend(std::coroutine_handle<> awaiting)
+	{
+		m_resume.handle = awaiting;
+		m_timer->Schedule(m_resume.Ptr(), m_delay);
+	}
+
+	void await_resume() const
+	{
+		m_resume.ThrowIfCancelled();
+	}
+
+private:
+	TimerServicePtr m_timer;
+
+	long long m_delay;
+
+	detail::CoroutineResumeTask m_resume;
+};
+
+/**
+ * @brief 挂起当前协程，在指定时间后于定时服务的线程池中恢复。
+ *
+ * @param timer 定时服务。
+ * @param delay_ms 延迟时间（毫秒）。
+ * @note 定时服务被 Shutdown 时尚未到期的协程不会再恢复；到期后线程池丢弃了恢复任务时
+ *       co_await 抛出 OperationCanceledException。
+ */
+inline delay_awaiter delay(TimerServicePtr timer, long long delay_ms)
+{
+	return delay_awaiter(timer, delay_ms);
+}
+
+/**
+ * @brief 挂起当前协程，在指定时间后于默认线程池中恢复，使用 GetDefaultTimerService()。
+ *
+ * @param delay_ms 延迟时间（毫秒）。
+ */
+inline delay_awaiter delay(long long delay_ms)
+{
+	return delay_awaiter(GetDefaultTimerService(), delay_ms);
+}
+
+/**
+ * @brief 等待所有协程结束。
+ *
+ * @param tasks 协程任务，在当前线程中依次启动，直到各自第一次挂起。
+ * @return 各协程结果组成的 tuple，void 协程对应 detail::void_result；任一协程抛出异常时重新抛出。
+ * @note 需要并行执行的协程应先 co_await schedule(pool)。
+ */
+template<typename... Ts>
+	requires (sizeof...(Ts) > 0)
+task<std::tuple<typename detail::when_all_result<Ts>::type...> > when_all(task<Ts>... tasks)
+{
+	detail::when_all_latch latch(sizeof...(Ts));
+	detail::notify_task parts[] = { detail::make_notify_task(tasks)... };
+	for (detail::notify_task& part : parts)
+		part.start(latch);
+	co_await latch;
+	co_return std::tuple<typename detail::when_all_result<Ts>::type...>(detail::when_all_result<Ts>::get(tasks)...);
+}
+
+/**
+ * @brief 没有协程时立即结束。
+ */
+inline task<std::tuple<> > when_all()
+{
+	co_return std::tuple<>();
+}
+
+/**
+ * @brief 等待一组协程全部结束。
+ *
+ * @param tasks 协程任务列表。
+ * @return 与输入顺序对应的结果列表；任一协程抛出异常时重新抛出。
+ */
+template<typename T>
+task<std::vector<T> > when_all(std::vector<task<T> > tasks)
+{
+	detail::when_all_latch latch(tasks.size());
+	std::vector<detail::notify_task> parts;
+	parts.reserve(tasks.size());
+	for (size_t i = 0; i < tasks.size(); i++)
+		parts.push_back(detail::make_notify_task(tasks[i]));
+	for (size_t i = 0; i < parts.size(); i++)
+		parts[i].start(latch);
+	co_await latch;
+
+	std::vector<T> results;
+	results.reserve(tasks.size());
+	for (size_t i = 0; i < tasks.size(); i++)
+		results.push_back(std::move(tasks[i].result()));
+	co_return results;
+}
+
+/**
+ * @brief 等待一组无返回值的协程全部结束。
+ *
+ * @param tasks 协程任务列表。
+ */
+inline task<void> when_all(std::vector<task<void> > tasks)
+{
+	detail::when_all_latch latch(tasks.size());
+	std::vector<detail::notify_task> parts;
+	parts.reserve(tasks.size());
+	for (size_t i = 0; i < tasks.size(); i++)
+		parts.push_back(detail::make_notify_task(tasks[i]));
+	for (size_t i = 0; i < parts.size(); i++)
+		parts[i].start(latch);
+	co_await latch;
+
+	for (size_t i = 0; i < tasks.size(); i++)
+		tasks[i].result();
+}
+
+/**
+ * @brief 阻塞当前线程直到协程结束，并返回其结果。
+ *
+ * @param t 协程任务，在当前线程中启动。
+ * @return 协程的结果；协程抛出异常时重新抛出。
+ * @note 不要在线程池的工作线程中等待需要同一线程池才能完成的协程。
+ */
+template<typename T>
+decltype(auto) sync_wait(task<T>&& t)
+{
+	detail::sync_wait_event event;
+	detail::notify_task part = detail::make_notify_task(t);
+	part.start(event);
+	event.wait();
+	if constexpr (std::is_void_v<T>)
+		t.result();
+	else
+		return T(std::move(t.result()));
+}
+
+}
+
+#endif
+
+#endif
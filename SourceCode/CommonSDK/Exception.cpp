@@ -100,6 +100,8 @@ void Exception::Throw(const char* type, const char* desc, const char* source, in
 		throw ArgumentException(desc).SetThrowSource(source, line);
 	if (strcmp(type, "ArithmeticException") == 0)
 		throw ArithmeticException(desc).SetThrowSource(source, line);
+	if (strcmp(type, "OperationCanceledException") == 0)
+		throw OperationCanceledException(desc).SetThrowSource(source, line);
 	if (strcmp(type, "NullPointerException") == 0)
 		throw NullPointerException(desc).SetThrowSource(source, line);
 	if (strcmp(type, "DataLockedException") == 0)
@@ -319,6 +319,16 @@ public:
 	InvalidOperationException(const std::string& desc) : RuntimeException(desc) { };
 };
 
+/**
+ * @brief 操作取消异常。指示操作或任务因取消请求而未执行或提前结束。
+ */
+class LIB_SDK OperationCanceledException : public RuntimeException
+{
+public:
+	OperationCanceledException(const OperationCanceledException& other) : RuntimeException(other) { };
+	OperationCanceledException(const std::string& desc) : RuntimeException(desc) { };
+};
+
 /**
  * @brief 空指针异常。指示在执行或计算过程中发现意外的空指针。
  */
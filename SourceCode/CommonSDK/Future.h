@@ -0,0 +1,245 @@
+﻿#ifndef _FM_SDK_FUTURE_H_
+#define _FM_SDK_FUTURE_H_
+
+#include <boost/atomic.hpp>
+#include <boost/optional.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "SystemExport.h"
+#include "ThreadTask.h"
+#include "Exception.h"
+
+namespace fm {
+
+/**
+ * @brief 异步结果共享状态的基类。
+ *
+ * 结果是否就绪由一个原子变量标识，等待者在结果就绪时无需进入内核；
+ * 只有结果未就绪且确实有线程在等待时，才会使用互斥量和条件变量。
+ */
+class FutureStateBase
+{
+public:
+	FutureStateBase() : m_ready(false), m_waiters(0) { }
+
+	virtual ~FutureStateBase() { }
+
+	/**
+	 * @brief 判断结果是否已经就绪。
+	 */
+	bool IsReady() const
+	{
+		return m_ready.load(boost::memory_order_acquire);
+	}
+
+	/**
+	 * @brief 等待结果就绪。
+	 */
+	void Wait()
+	{
+		if (IsReady())
+			return;
+
+		// 先短暂自旋，短任务通常能在此期间完成
+		for (int i = 0; i < SPIN_COUNT; i++)
+		{
+			if (IsReady())
+				return;
+		}
+
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		m_waiters.fetch_add(1);
+		while (!IsReady())
+			m_condition.wait(lock);
+		m_waiters.fetch_sub(1);
+	}
+
+	/**
+	 * @brief 若执行过程中抛出了异常则重新抛出。
+	 */
+	void RethrowIfFailed() const
+	{
+		if (m_exception)
+			boost::rethrow_exception(m_exception);
+	}
+
+	/**
+	 * @brief 以异常结束。任务执行失败或未能执行（例如被线程池拒绝）时调用。
+	 */
+	void SetException(const boost::exception_ptr& e)
+	{
+		m_exception = e;
+		SetReady();
+	}
+
+protected:
+	void SetReady()
+	{
+		m_ready.store(true);
+		boost::atomic_thread_fence(boost::memory_order_seq_cst);
+		if (m_waiters.load(boost::memory_order_relaxed) > 0)
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			m_condition.notify_all();
+		}
+	}
+
+private:
+	FutureStateBase(const FutureStateBase&);
+	FutureStateBase& operator=(const FutureStateBase&);
+
+	static const int SPIN_COUNT = 128;
+
+	boost::atomic<bool> m_ready;
+	boost::atomic<int> m_waiters;
+	boost::mutex m_mutex;
+	boost::condition_variable m_condition;
+	boost::exception_ptr m_exception;
+};
+
+/**
+ * @brief 带返回值的异步结果共享状态。
+ */
+template<typename R>
+class FutureState : public FutureStateBase
+{
+public:
+	const R& Value() const
+	{
+		RethrowIfFailed();
+		return *m_value;
+	}
+
+protected:
+	template<typename F>
+	void Invoke(F& func)
+	{
+		try
+		{
+			m_value = func();
+		}
+		catch (...)
+		{
+			SetException(boost::current_exception());
+			return;
+		}
+		SetReady();
+	}
+
+private:
+	boost::optional<R> m_value;
+};
+
+/**
+ * @brief 无返回值的异步结果共享状态。
+ */
+template<>
+class FutureState<void> : public FutureStateBase
+{
+public:
+	void Value() const
+	{
+		RethrowIfFailed();
+	}
+
+protected:
+	template<typename F>
+	void Invoke(F& func)
+	{
+		try
+		{
+			func();
+		}
+		catch (...)
+		{
+			SetException(boost::current_exception());
+			return;
+		}
+		SetReady();
+	}
+};
+
+/**
+ * @brief 将可调用对象和结果共享状态合并为一个线程任务。
+ *
+ * 通过 MakeTask 创建时，任务对象、共享状态以及引用计数控制块位于任务内存池的同一个块中。
+ */
+template<typename R, typename F>
+class FutureTask : public FutureState<R>, public ThreadTask
+{
+public:
+	explicit FutureTask(const F& func) : m_func(func) { }
+
+	void Execute()
+	{
+		this->Invoke(m_func);
+	}
+
+	void Cancel()
+	{
+		this->SetException(boost::copy_exception(OperationCanceledException("ThreadPool task was cancelled before it ran.")));
+	}
+
+private:
+	F m_func;
+};
+
+/**
+ * @brief 异步结果。
+ *
+ * Future 对象由 ThreadPool::Submit 返回，用于等待任务完成并获取其返回值。
+ * 任务执行中抛出的异常会在调用 Get() 时重新抛出。
+ * @note 异常通过 boost::current_exception 捕获，在不支持 C++11 异常传递的编译器上，
+ *       非 boost::exception 派生的异常将以 boost::unknown_exception 的形式重新抛出。
+ */
+template<typename R>
+class Future
+{
+public:
+	Future() { }
+
+	explicit Future(const boost::shared_ptr<FutureState<R> >& state) : m_state(state) { }
+
+	/**
+	 * @brief 判断是否关联了有效的异步结果。
+	 */
+	bool Valid() const
+	{
+		return m_state.get() != NULL;
+	}
+
+	/**
+	 * @brief 判断结果是否已经就绪，不会阻塞。
+	 */
+	bool IsReady() const
+	{
+		return m_state && m_state->IsReady();
+	}
+
+	/**
+	 * @brief 等待结果就绪。
+	 */
+	void Wait() const
+	{
+		m_state->Wait();
+	}
+
+	/**
+	 * @brief 等待并获取结果。
+	 *
+	 * @return 任务的返回值。
+	 */
+	R Get() const
+	{
+		m_state->Wait();
+		return m_state->Value();
+	}
+
+private:
+	boost::shared_ptr<FutureState<R> > m_state;
+};
+
+}
+
+#endif
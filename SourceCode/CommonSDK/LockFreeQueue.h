@@ -0,0 +1,195 @@
+﻿#ifndef _FM_SDK_LOCKFREE_QUEUE_H_
+#define _FM_SDK_LOCKFREE_QUEUE_H_
+
+#include <cstddef>
+#include <algorithm>
+#include <boost/atomic.hpp>
+#include "SystemExport.h"
+
+namespace fm {
+
+/**
+ * @brief 有界无锁多生产者/多消费者队列。
+ *
+ * LockFreeQueue 基于环形缓冲区实现，每个槽位带有序号，生产者和消费者分别通过
+ * CAS 竞争写入/读取位置，不使用任何互斥锁。队列容量在构造时确定并向上取整为 2 的幂。
+ * @note 队列满时 TryPush 返回 false，队列空时 TryPop 返回 false，调用者需自行决定
+ *       等待或降级处理的方式。
+ */
+template<typename T>
+class LockFreeQueue
+{
+public:
+	/**
+	 * @brief 构造函数。
+	 *
+	 * @param capacity 队列容量（会向上取整为 2 的幂，最小为 2）。
+	 */
+	explicit LockFreeQueue(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+
+		m_mask  = size - 1;
+		m_cells = new Cell[size];
+		for (size_t i = 0; i < size; i++)
+			m_cells[i].sequence.store(i, boost::memory_order_relaxed);
+
+		m_enqueuePos.store(0, boost::memory_order_relaxed);
+		m_dequeuePos.store(0, boost::memory_order_relaxed);
+	}
+
+	~LockFreeQueue()
+	{
+		delete[] m_cells;
+	}
+
+	/**
+	 * @brief 尝试将元素加入队尾。
+	 *
+	 * @param value 要加入的元素。
+	 * @return 成功返回 true，队列已满返回 false。
+	 */
+	bool TryPush(const T& value)
+	{
+		Cell* cell;
+		size_t pos = m_enqueuePos.load(boost::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			size_t seq = cell->sequence.load(boost::memory_order_acquire);
+			std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+			if (diff == 0)
+			{
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = m_enqueuePos.load(boost::memory_order_relaxed);
+		}
+
+		cell->data = value;
+		cell->sequence.store(pos + 1, boost::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief 尝试将一组元素连续加入队尾。
+	 *
+	 * @param values 要加入的元素数组。
+	 * @param count 元素个数。
+	 * @return 全部加入返回 true；剩余空间不足时不加入任何元素并返回 false。
+	 * @note 整组元素只通过一次 CAS 预留位置，生产者之间仅竞争一次。
+	 */
+	bool TryPushBulk(const T* values, size_t count)
+	{
+		if (count == 0)
+			return true;
+		if (count > m_mask + 1)
+			return false;
+
+		size_t pos = m_enqueuePos.load(boost::memory_order_relaxed);
+		for (;;)
+		{
+			// 只有预留范围内所有槽位的上一轮元素都已被消费者领取时，才能整体预留
+			size_t head = m_dequeuePos.load(boost::memory_order_acquire);
+			if ((std::ptrdiff_t)(pos + count - head) > (std::ptrdiff_t)(m_mask + 1))
+				return false;
+			if (m_enqueuePos.compare_exchange_weak(pos, pos + count, boost::memory_order_relaxed))
+				break;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			Cell* cell = &m_cells[(pos + i) & m_mask];
+
+			// 等待领取该槽位的消费者完成读取
+			while (cell->sequence.load(boost::memory_order_acquire) != pos + i)
+			{
+			}
+			cell->data = values[i];
+			cell->sequence.store(pos + i + 1, boost::memory_order_release);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief 尝试从队首取出元素。
+	 *
+	 * @param value 取出的元素。
+	 * @return 成功返回 true，队列为空返回 false。
+	 */
+	bool TryPop(T& value)
+	{
+		Cell* cell;
+		size_t pos = m_dequeuePos.load(boost::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			size_t seq = cell->sequence.load(boost::memory_order_acquire);
+			std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+			if (diff == 0)
+			{
+				if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = m_dequeuePos.load(boost::memory_order_relaxed);
+		}
+
+		// 取出后立即清空槽位，避免队列继续持有已出队的对象
+		using std::swap;
+		swap(value, cell->data);
+		cell->data = T();
+		cell->sequence.store(pos + m_mask + 1, boost::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief 获取队列容量。
+	 */
+	size_t Capacity() const
+	{
+		return m_mask + 1;
+	}
+
+	/**
+	 * @brief 获取队列中元素的近似个数（并发修改时仅供参考）。
+	 */
+	size_t SizeApprox() const
+	{
+		size_t tail = m_enqueuePos.load(boost::memory_order_relaxed);
+		size_t head = m_dequeuePos.load(boost::memory_order_relaxed);
+		return tail > head ? tail - head : 0;
+	}
+
+private:
+	LockFreeQueue(const LockFreeQueue&);
+	LockFreeQueue& operator=(const LockFreeQueue&);
+
+	struct Cell
+	{
+		boost::atomic<size_t> sequence;
+		T data;
+	};
+
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	char m_pad0[CACHE_LINE_SIZE];
+	Cell* m_cells;
+	size_t m_mask;
+	char m_pad1[CACHE_LINE_SIZE];
+	boost::atomic<size_t> m_enqueuePos;
+	char m_pad2[CACHE_LINE_SIZE];
+	boost::atomic<size_t> m_dequeuePos;
+	char m_pad3[CACHE_LINE_SIZE];
+};
+
+}
+
+#endif
@@ -3,7 +3,11 @@
 #include <Windows.h>
 #include <io.h>
 #endif
+#include <algorithm>
+#include <cstring>
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
 #include "Logging.h"
 #include "DateTime.h"
 
@@ -27,6 +31,15 @@ public:
 
 	void Log(LoggingMessage& message);
 
+	// 输出一条日志：写入日志文件并通知侦听器和标准流
+	void Write(const char* name, int severity, const char* text, size_t size);
+
+	// 向日志文件写入一段文本，必要时回滚日志卷
+	void WriteFile(const char* data, size_t size);
+
+	// 通知侦听器和标准流
+	void Dispatch(const char* name, int severity, const char* text, size_t size);
+
 private:
 	void CreateLogFile();
 
@@ -39,14 +52,300 @@ private:
 	std::string host, user;
 	int log_config, log_file_size;
 	boost::mutex log_mutex;
+	bool async, async_drop;
 
 	const int MAX_LOGFILE_SIZE;
 };
 
+// 异步日志每个线程的缓冲区大小（字节）
+const size_t ASYNC_LOG_BUFFER_SIZE = 128 * 1024;
+
+// 后台线程没有新日志时的等待间隔（毫秒）
+const int ASYNC_LOG_INTERVAL = 5;
+
+// 异步日志记录的头部，后接日志名称和日志文本
+struct AsyncLogRecord
+{
+	LoggingImpl* impl;
+	int severity;
+	unsigned int name_size;
+	unsigned int text_size;
+};
+
+// 单生产者单消费者的字节环形缓冲区。所属线程追加日志记录，后台线程读取，
+// 读写位置单调递增，各自以 release 语义发布
+class AsyncLogBuffer
+{
+public:
+	AsyncLogBuffer() : closed(false), buffer(new char[ASYNC_LOG_BUFFER_SIZE]), head(0), tail(0)
+	{
+	}
+
+	~AsyncLogBuffer()
+	{
+		delete[] buffer;
+	}
+
+	bool TryWrite(const AsyncLogRecord& record, const char* name, const char* text)
+	{
+		size_t size = sizeof(record) + record.name_size + record.text_size;
+		size_t pos  = tail.load(boost::memory_order_relaxed);
+		if (ASYNC_LOG_BUFFER_SIZE - (pos - head.load(boost::memory_order_acquire)) < size)
+			return false;
+
+		Put(pos, &record, sizeof(record));
+		Put(pos + sizeof(record), name, record.name_size);
+		Put(pos + sizeof(record) + record.name_size, text, record.text_size);
+		tail.store(pos + size, boost::memory_order_release);
+		return true;
+	}
+
+	bool TryRead(AsyncLogRecord& record, std::string& name, std::string& text)
+	{
+		size_t pos = head.load(boost::memory_order_relaxed);
+		if (pos == tail.load(boost::memory_order_acquire))
+			return false;
+
+		Get(pos, &record, sizeof(record));
+		name.resize(record.name_size);
+		text.resize(record.text_size);
+		if (record.name_size != 0)
+			Get(pos + sizeof(record), &name[0], record.name_size);
+		if (record.text_size != 0)
+			Get(pos + sizeof(record) + record.name_size, &text[0], record.text_size);
+		head.store(pos + sizeof(record) + record.name_size + record.text_size, boost::memory_order_release);
+		return true;
+	}
+
+	size_t Size() const
+	{
+		return tail.load(boost::memory_order_relaxed) - head.load(boost::memory_order_relaxed);
+	}
+
+	// 所属线程已退出，缓冲区读空后由后台线程回收
+	boost::atomic<bool> closed;
+
+private:
+	void Put(size_t pos, const void* data, size_t size)
+	{
+		size_t offset = pos % ASYNC_LOG_BUFFER_SIZE;
+		size_t first  = std::min(size, ASYNC_LOG_BUFFER_SIZE - offset);
+		memcpy(buffer + offset, data, first);
+		memcpy(buffer, static_cast<const char*>(data) + first, size - first);
+	}
+
+	void Get(size_t pos, void* data, size_t size) const
+	{
+		size_t offset = pos % ASYNC_LOG_BUFFER_SIZE;
+		size_t first  = std::min(size, ASYNC_LOG_BUFFER_SIZE - offset);
+		memcpy(data, buffer + offset, first);
+		memcpy(static_cast<char*>(data) + first, buffer, size - first);
+	}
+
+	char* buffer;
+	boost::atomic<size_t> head;
+	boost::atomic<size_t> tail;
+};
+
+typedef boost::shared_ptr<AsyncLogBuffer> AsyncLogBufferPtr;
+
+// 异步日志的后台输出线程，以及所有线程的日志缓冲区
+class AsyncLogWriter
+{
+public:
+	AsyncLogWriter() : running(false), stopping(false), flush_requested(0), flush_completed(0), dropped(0)
+	{
+	}
+
+	// 启动后台线程，已启动时不做任何处理
+	void Start();
+
+	// 写出所有日志后停止后台线程
+	void Stop();
+
+	// 追加一条日志，缓冲区已满时按 drop 丢弃或阻塞等待
+	void Append(LoggingImpl* impl, const char* name, int severity, const char* text, size_t size, bool drop);
+
+	// 等待调用前追加的日志全部写出
+	void Flush();
+
+	long long DroppedCount() const
+	{
+		return dropped.load(boost::memory_order_relaxed);
+	}
+
+private:
+	AsyncLogBuffer* ThreadBuffer();
+
+	void Wake();
+
+	void Run();
+
+	// 读出所有缓冲区中的日志，按日志成批写入文件
+	void Drain(const std::vector<AsyncLogBufferPtr>& buffers);
+
+	boost::mutex mutex;
+	boost::condition_variable wake_condition;
+	boost::condition_variable flush_condition;
+	boost::shared_ptr<boost::thread> thread;
+	std::vector<AsyncLogBufferPtr> buffers;
+	bool running, stopping;
+	long long flush_requested, flush_completed;
+	boost::atomic<long long> dropped;
+
+	// 后台线程读取日志时复用的缓冲区
+	std::map<LoggingImpl*, std::string> batches;
+	std::string record_name, record_text;
+};
+
+// 命名日志的槽位，创建后不再删除，地址保持不变
+struct LoggerSlot
+{
+	explicit LoggerSlot(const char* name) : name(name), impl(NULL), severity(-1), users(0)
+	{
+	}
+
+	// 开始使用日志，返回 NULL 表示日志未打开。无论结果如何都要调用 Leave()
+	LoggingImpl* Enter()
+	{
+		users.fetch_add(1);
+		return impl.load();
+	}
+
+	void Leave()
+	{
+		users.fetch_sub(1, boost::memory_order_release);
+	}
+
+	// 摘下日志并等待正在使用它的线程全部离开，之后可以安全地删除返回的日志
+	LoggingImpl* Detach()
+	{
+		LoggingImpl* old = impl.exchange(NULL);
+		while( users.load() != 0 )
+			boost::this_thread::yield();
+		return old;
+	}
+
+	std::string name;
+	boost::atomic<LoggingImpl*> impl;
+
+	// 单独设置的日志级别，小于 0 表示使用全局的日志级别
+	boost::atomic<int> severity;
+
+	// 正在使用 impl 的线程数
+	boost::atomic<long> users;
+};
+
+// 开放寻址的槽位散列表，负载不超过一半
+struct LoggerTable
+{
+	explicit LoggerTable(size_t capacity) : mask(capacity - 1), buckets(new boost::atomic<LoggerSlot*>[capacity])
+	{
+		for( size_t i = 0; i < capacity; i++ )
+			buckets[i].store(NULL, boost::memory_order_relaxed);
+	}
+
+	~LoggerTable()
+	{
+		delete[] buckets;
+	}
+
+	size_t mask;
+	boost::atomic<LoggerSlot*>* buckets;
+};
+
+// 命名日志的注册表。槽位只增不删，写入者加锁后把槽位以 release 语义放入空桶，读者不加锁查找，
+// 也不构造 std::string。扩容时把槽位复制到新表再发布，旧表保留到注册表析构，读者不会访问已释放的内存
+class LoggerRegistry
+{
+public:
+	LoggerRegistry() : table(NULL)
+	{
+		tables.push_back(new LoggerTable(16));
+		table.store(tables.back(), boost::memory_order_release);
+	}
+
+	~LoggerRegistry()
+	{
+		for( size_t i = 0; i < tables.size(); i++ )
+			delete tables[i];
+		for( size_t i = 0; i < slots.size(); i++ )
+			delete slots[i];
+	}
+
+	// 查找指定名字的槽位，不存在时返回 NULL
+	LoggerSlot* Find(const char* name) const
+	{
+		const LoggerTable* current = table.load(boost::memory_order_acquire);
+		for( size_t i = Hash(name) & current->mask; ; i = (i + 1) & current->mask ) {
+			LoggerSlot* slot = current->buckets[i].load(boost::memory_order_acquire);
+			if( slot == NULL )
+				return NULL;
+			if( strcmp(slot->name.c_str(), name) == 0 )
+				return slot;
+		}
+	}
+
+	// 查找指定名字的槽位，不存在时创建
+	LoggerSlot* Acquire(const char* name)
+	{
+		LoggerSlot* slot = Find(name);
+		if( slot != NULL )
+			return slot;
+
+		boost::lock_guard<boost::mutex> lock(mutex);
+		slot = Find(name);
+		if( slot != NULL )
+			return slot;
+
+		slot = new LoggerSlot(name);
+		LoggerTable* current = table.load(boost::memory_order_relaxed);
+		if( (slots.size() + 1) * 2 > current->mask + 1 ) {
+			current = new LoggerTable((current->mask + 1) * 2);
+			for( size_t i = 0; i < slots.size(); i++ )
+				Insert(current, slots[i]);
+			tables.push_back(current);
+			table.store(current, boost::memory_order_release);
+		}
+		Insert(current, slot);
+		slots.push_back(slot);
+		return slot;
+	}
+
+	// 获取所有槽位
+	std::vector<LoggerSlot*> Slots()
+	{
+		boost::lock_guard<boost::mutex> lock(mutex);
+		return slots;
+	}
+
+private:
+	static size_t Hash(const char* name)
+	{
+		size_t hash = 2166136261u;
+		for( ; *name != 0; name++ )
+			hash = (hash ^ (unsigned char)*name) * 16777619u;
+		return hash;
+	}
+
+	static void Insert(LoggerTable* target, LoggerSlot* slot)
+	{
+		size_t i = Hash(slot->name.c_str()) & target->mask;
+		while( target->buckets[i].load(boost::memory_order_relaxed) != NULL )
+			i = (i + 1) & target->mask;
+		target->buckets[i].store(slot, boost::memory_order_release);
+	}
+
+	boost::atomic<LoggerTable*> table;
+	std::vector<LoggerTable*> tables;
+	std::vector<LoggerSlot*> slots;
+	boost::mutex mutex;
+};
+
 // 日志系统类，包含所有的有效日志及相关配置。
 struct LoggingSystem
 {
-	LoggingSystem() : default_logging(NULL)
+	LoggingSystem() : timestamp_precision(LOG_TIME_SECOND), default_logging(NULL)
 	{
 #ifdef _DEBUG
 		severity = SEV_DEBUG;
@@ -58,14 +357,25 @@ struct LoggingSystem
 	// 输出的日志级别
 	int severity;
 
+	// 日志时间戳秒以下的小数位数
+	int timestamp_precision;
+
 	// 实现向其它侦听者发送日志
 	std::list<LoggingListener*> listeners;
 	boost::mutex listener_mutex;
 
-	// 所有打开的日志
-	LoggingImpl* default_logging;
-	std::map<std::string, LoggingImpl*> loggings;
+	// 所有命名日志的槽位，default_logging 指向第一个打开的日志。logging_mutex 串行化日志的打开和关闭
+	boost::atomic<LoggerSlot*> default_logging;
+	LoggerRegistry loggings;
 	boost::mutex logging_mutex;
+
+	// 异步日志输出
+	AsyncLogWriter async_writer;
+
+	~LoggingSystem()
+	{
+		async_writer.Stop();
+	}
 };
 
 static LoggingSystem& GetLoggingSystem()
@@ -76,7 +386,8 @@ static LoggingSystem& GetLoggingSystem()
 
 LoggingImpl::LoggingImpl(const char* name, const char* path, int config, int rollover)
 	: rollover_size(rollover), rollover_frequency(8), rollover_attempt(0), log_file(NULL), log_name(name==NULL?"":name),
-	  log_path(path==NULL?"":path), log_config(config), log_file_size(0), MAX_LOGFILE_SIZE(16*1024*1024)
+	  log_path(path==NULL?"":path), log_config(config), log_file_size(0), async((config & LOG_ASYNC) != 0),
+	  async_drop((config & LOG_ASYNC_DROP) != 0), MAX_LOGFILE_SIZE(16*1024*1024)
 {
 	if( (log_config & LOG_NO_FILE_CREATED) == 0 ) {
 		//host = GetHostName(false);
@@ -95,14 +406,37 @@ LoggingImpl::~LoggingImpl()
 
 void LoggingImpl::Log(LoggingMessage& message)
 {
-	std::string log_text = message.Stream(false).str();
+	if( async ) {
+		AsyncLogWriter& writer = GetLoggingSystem().async_writer;
+		writer.Append(this, message.Name(), message.Severity(), message.Text(), message.TextSize(), async_drop);
+		// 严重错误可能紧接着导致程序退出，等待日志写出
+		if( message.Severity() == SEV_FATAL )
+			writer.Flush();
+		return;
+	}
 
+	Write(message.Name(), message.Severity(), message.Text(), message.TextSize());
+}
+
+void LoggingImpl::Write(const char* name, int severity, const char* text, size_t size)
+{
+	WriteFile(text, size);
+	if( severity == SEV_FATAL && log_file != NULL ) {
+		boost::lock_guard<boost::mutex> lock(log_mutex);
+		fflush(log_file);
+	}
+	Dispatch(name, severity, text, size);
+}
+
+void LoggingImpl::WriteFile(const char* data, size_t size)
+{
 	if( log_file != NULL ) {
 		boost::lock_guard<boost::mutex> lock(log_mutex);
 		// 向日志文件输出日志
 		if( log_file_size >= MAX_LOGFILE_SIZE ) {
 			// 创建新的日志文件
 			fclose(log_file);
+			log_file = NULL;
 
 			rollover_attempt++;
 			if( rollover_attempt >= rollover_frequency )
@@ -111,30 +445,48 @@ void LoggingImpl::Log(LoggingMessage& message)
 			CreateLogFile();
 			log_file_size = 0;
 		}
-		int text_size = int(log_text.length());
-		log_file_size += text_size;
-		fwrite(log_text.c_str(), 1, text_size, log_file);
+		if( log_file != NULL ) {
+			log_file_size += int(size);
+			fwrite(data, 1, size, log_file);
+			if( async )
+				fflush(log_file);
+		}
 	}
+}
+
+// 当前线程是否正在通知侦听器
+static FM_THREAD_LOCAL bool t_dispatching = false;
+
+// 在作用域内标记当前线程正在通知侦听器，侦听器抛出异常时同样复位
+struct ListenerDispatchScope
+{
+	ListenerDispatchScope() { t_dispatching = true; }
+	~ListenerDispatchScope() { t_dispatching = false; }
+};
 
-	// 发送日志信息给Listener
+void LoggingImpl::Dispatch(const char* name, int severity, const char* text, size_t size)
+{
+	// 发送日志信息给Listener。侦听器中输出的日志不再发送给侦听器，
+	// 既避免无限递归，也避免在同一线程中重复获取 listener_mutex 而死锁
 	LoggingSystem& logging_system = GetLoggingSystem();
-	if( !logging_system.listeners.empty() && (LOG_IGNORE_LISTENER & log_config) == 0 ) {
+	if( !t_dispatching && !logging_system.listeners.empty() && (LOG_IGNORE_LISTENER & log_config) == 0 ) {
 		boost::lock_guard<boost::mutex> lock(logging_system.listener_mutex);
+		ListenerDispatchScope scope;
 		for(std::list<LoggingListener*>::iterator it = logging_system.listeners.begin();
 			it != logging_system.listeners.end();
 			++it)
-			(*it)->Log(message.Name(), message.Severity(), log_text);
+			(*it)->Log(name, severity, text, size);
 	}
 
 	// 发送日志信息给标准输出
 	if( (log_config & LOG_STD_STREAM) != 0 ) {
-		if( message.Severity() <= SEV_ERROR )
-			std::cerr<<log_text;
+		if( severity <= SEV_ERROR )
+			std::cerr.write(text, size);
 		else
-			std::cout<<log_text;
+			std::cout.write(text, size);
 	}
 #if (defined(WIN32) || defined(_WINDOWS)) && defined(_DEBUG)
-	::OutputDebugStringA(log_text.c_str());
+	::OutputDebugStringA(std::string(text, size).c_str());
 #endif
 }
 
@@ -174,6 +526,170 @@ void LoggingImpl::CreateLogFile()
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// 当前线程的异步日志缓冲区，以及当前线程是否为异步日志的后台线程
+static FM_THREAD_LOCAL AsyncLogBuffer* t_logBuffer = NULL;
+static FM_THREAD_LOCAL bool t_logWriter = false;
+
+// 线程退出时标记其缓冲区并释放线程持有的引用。缓冲区由线程和后台线程共同持有，
+// 后台线程已经释放缓冲区时（如日志系统先于线程局部存储析构）不会访问已释放的内存
+static void CloseLogBuffer(AsyncLogBufferPtr* buffer)
+{
+	(*buffer)->closed.store(true, boost::memory_order_release);
+	if( t_logBuffer == buffer->get() )
+		t_logBuffer = NULL;
+	delete buffer;
+}
+
+static boost::thread_specific_ptr<AsyncLogBufferPtr> log_buffer_owner(&CloseLogBuffer);
+
+void AsyncLogWriter::Start()
+{
+	boost::lock_guard<boost::mutex> lock(mutex);
+	if( running )
+		return;
+	running  = true;
+	stopping = false;
+	thread.reset(new boost::thread(boost::bind(&AsyncLogWriter::Run, this)));
+}
+
+void AsyncLogWriter::Stop()
+{
+	boost::shared_ptr<boost::thread> writer_thread;
+	{
+		boost::lock_guard<boost::mutex> lock(mutex);
+		if( !running )
+			return;
+		stopping = true;
+		wake_condition.notify_all();
+		writer_thread.swap(thread);
+	}
+	writer_thread->join();
+
+	boost::lock_guard<boost::mutex> lock(mutex);
+	running = false;
+	flush_condition.notify_all();
+}
+
+AsyncLogBuffer* AsyncLogWriter::ThreadBuffer()
+{
+	if( t_logBuffer == NULL ) {
+		AsyncLogBufferPtr buffer(new AsyncLogBuffer());
+		{
+			boost::lock_guard<boost::mutex> lock(mutex);
+			buffers.push_back(buffer);
+		}
+		log_buffer_owner.reset(new AsyncLogBufferPtr(buffer));
+		t_logBuffer = buffer.get();
+	}
+	return t_logBuffer;
+}
+
+void AsyncLogWriter::Append(LoggingImpl* impl, const char* name, int severity, const char* text, size_t size, bool drop)
+{
+	AsyncLogRecord record;
+	record.impl      = impl;
+	record.severity  = severity;
+	record.name_size = name == NULL ? 0 : (unsigned int)strlen(name);
+	record.text_size = (unsigned int)size;
+
+	// 后台线程自身（例如侦听器中）输出的日志以及超过缓冲区大小的日志直接同步输出，
+	// 侦听器中输出的日志只写入文件和标准流，不再发送给侦听器（见 LoggingImpl::Dispatch）
+	if( t_logWriter || sizeof(record) + record.name_size + record.text_size > ASYNC_LOG_BUFFER_SIZE ) {
+		if( !t_logWriter )
+			Flush();
+		impl->Write(name, severity, text, size);
+		return;
+	}
+
+	AsyncLogBuffer* buffer = ThreadBuffer();
+	while( !buffer->TryWrite(record, name, text) ) {
+		if( drop ) {
+			dropped.fetch_add(1, boost::memory_order_relaxed);
+			return;
+		}
+		Wake();
+		boost::this_thread::sleep_for(boost::chrono::microseconds(100));
+	}
+
+	// 缓冲区超过一半时提前唤醒后台线程，其余情况由后台线程定期检查
+	if( buffer->Size() > ASYNC_LOG_BUFFER_SIZE / 2 )
+		Wake();
+}
+
+void AsyncLogWriter::Flush()
+{
+	if( t_logWriter )
+		return;
+
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if( !running )
+		return;
+	long long request = ++flush_requested;
+	wake_condition.notify_all();
+	while( running && flush_completed < request )
+		flush_condition.wait(lock);
+}
+
+void AsyncLogWriter::Wake()
+{
+	boost::lock_guard<boost::mutex> lock(mutex);
+	wake_condition.notify_all();
+}
+
+void AsyncLogWriter::Run()
+{
+	t_logWriter = true;
+	boost::unique_lock<boost::mutex> lock(mutex);
+	while( true ) {
+		long long request = flush_requested;
+		bool stop = stopping;
+		std::vector<AsyncLogBufferPtr> snapshot = buffers;
+		lock.unlock();
+
+		Drain(snapshot);
+
+		lock.lock();
+		// 回收所属线程已退出且已读空的缓冲区
+		for( size_t i = 0; i < buffers.size(); ) {
+			if( buffers[i]->closed.load(boost::memory_order_acquire) && buffers[i]->Size() == 0 )
+				buffers.erase(buffers.begin() + i);
+			else
+				i++;
+		}
+		if( flush_completed < request ) {
+			flush_completed = request;
+			flush_condition.notify_all();
+		}
+		if( stop )
+			break;
+		// 定期成批写出，缓冲区过半、Flush 或停止时被提前唤醒
+		if( flush_requested == flush_completed && !stopping )
+			wake_condition.wait_for(lock, boost::chrono::milliseconds(ASYNC_LOG_INTERVAL));
+	}
+	t_logWriter = false;
+}
+
+void AsyncLogWriter::Drain(const std::vector<AsyncLogBufferPtr>& snapshot)
+{
+	AsyncLogRecord record;
+	for( size_t i = 0; i < snapshot.size(); i++ ) {
+		while( snapshot[i]->TryRead(record, record_name, record_text) ) {
+			batches[record.impl] += record_text;
+			record.impl->Dispatch(record.name_size == 0 ? NULL : record_name.c_str(), record.severity,
+				record_text.data(), record_text.size());
+		}
+	}
+
+	// 每个日志的一批文本只写一次文件。日志关闭前会等待写出，已关闭日志的空批次不会再被使用
+	for( std::map<LoggingImpl*, std::string>::iterator it = batches.begin(); it != batches.end(); ++it ) {
+		if( !it->second.empty() ) {
+			it->first->WriteFile(it->second.data(), it->second.size());
+			it->second.clear();
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 Logging::Logging()
 {
@@ -193,11 +709,13 @@ void Logging::Init(const char* name, const char* path, int config, int rollover)
 
 	LoggingSystem& system = GetLoggingSystem();
 	boost::lock_guard<boost::mutex> lock(system.logging_mutex);
-	if( system.loggings.find(log_name) == system.loggings.end() ) {
-		LoggingImpl* impl = new LoggingImpl(log_name, path, config, rollover);
-		system.loggings[log_name] = impl;
-		if( system.default_logging == NULL )
-			system.default_logging = impl;
+	LoggerSlot* slot = system.loggings.Acquire(log_name);
+	if( slot->impl.load() == NULL ) {
+		if( (config & LOG_ASYNC) != 0 )
+			system.async_writer.Start();
+		slot->impl.store(new LoggingImpl(log_name, path, config, rollover));
+		if( system.default_logging.load() == NULL )
+			system.default_logging.store(slot);
 	}
 }
 
@@ -224,68 +742,313 @@ int& Logging::Severity()
 	return GetLoggingSystem().severity;
 }
 
+void Logging::SetSeverity(const char* name, int severity)
+{
+	LoggingSystem& system = GetLoggingSystem();
+	if( name == NULL ) {
+		system.severity = severity;
+		return;
+	}
+
+	LoggerSlot* slot = (severity < 0) ? system.loggings.Find(name) : system.loggings.Acquire(name);
+	if( slot != NULL )
+		slot->severity.store(severity < 0 ? -1 : severity, boost::memory_order_relaxed);
+}
+
+int Logging::GetSeverity(const char* name)
+{
+	LoggingSystem& system = GetLoggingSystem();
+	if( name != NULL ) {
+		LoggerSlot* slot = system.loggings.Find(name);
+		if( slot != NULL ) {
+			int severity = slot->severity.load(boost::memory_order_relaxed);
+			if( severity >= 0 )
+				return severity;
+		}
+	}
+	return system.severity;
+}
+
+bool Logging::IsEnabled(const char* name, int severity)
+{
+	if( name == NULL )
+		return severity <= GetLoggingSystem().severity;
+	return severity <= GetSeverity(name);
+}
+
+int& Logging::TimestampPrecision()
+{
+	return GetLoggingSystem().timestamp_precision;
+}
+
+void Logging::Flush()
+{
+	GetLoggingSystem().async_writer.Flush();
+}
+
+long long Logging::DroppedCount()
+{
+	return GetLoggingSystem().async_writer.DroppedCount();
+}
+
 void Logging::Shutdown(const char* name)
 {
 	LoggingSystem& system = GetLoggingSystem();
 	boost::lock_guard<boost::mutex> lock(system.logging_mutex);
+	// 先摘下日志，等正在输出的线程离开后写出异步缓冲区中的日志，再关闭日志
+	std::vector<LoggingImpl*> closed;
 	if( name == NULL ) {
-		std::map<std::string, LoggingImpl*>::iterator it = system.loggings.begin();
-		while( it != system.loggings.end() ) {
-			delete it->second;
-			it++;
-		}
-		system.loggings.clear();
-		system.default_logging = NULL;
+		system.default_logging.store(NULL);
+		std::vector<LoggerSlot*> slots = system.loggings.Slots();
+		for( size_t i = 0; i < slots.size(); i++ )
+			closed.push_back(slots[i]->Detach());
 	} else {
-		std::map<std::string, LoggingImpl*>::iterator it = system.loggings.find(name);
-		if( it != system.loggings.end() ) {
-			if( it->second == system.default_logging )
-				system.default_logging = NULL;
-			delete it->second;
-			system.loggings.erase(it);
+		LoggerSlot* slot = system.loggings.Find(name);
+		if( slot != NULL ) {
+			LoggerSlot* expected = slot;
+			system.default_logging.compare_exchange_strong(expected, NULL);
+			closed.push_back(slot->Detach());
 		}
 	}
+
+	system.async_writer.Flush();
+	for( size_t i = 0; i < closed.size(); i++ )
+		delete closed[i];
+	if( name == NULL )
+		system.async_writer.Stop();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-LoggingMessage::LoggingMessage(const char* name, int severity) : log_severity(severity), log_name(name)
+// 日志消息的格式化缓冲区，在同一线程的多条消息之间复用
+class LoggingStream : public std::streambuf
+{
+public:
+	LoggingStream() : stream(this), buffer(INITIAL_SIZE)
+	{
+		Reset();
+	}
+
+	// 清空内容并恢复流的默认格式，过大的缓冲区缩小到初始大小
+	void Reset()
+	{
+		if( buffer.size() > MAX_RETAINED_SIZE )
+			std::vector<char>(INITIAL_SIZE).swap(buffer);
+		setp(&buffer[0], &buffer[0] + buffer.size());
+		stream.clear();
+		stream.flags(std::ios::dec | std::ios::skipws);
+		stream.precision(6);
+		stream.fill(' ');
+		stream.width(0);
+	}
+
+	const char* Data() const
+	{
+		return pbase();
+	}
+
+	size_t Size() const
+	{
+		return size_t(pptr() - pbase());
+	}
+
+	std::ostream stream;
+
+protected:
+	int_type overflow(int_type c)
+	{
+		Reserve(1);
+		if( !traits_type::eq_int_type(c, traits_type::eof()) ) {
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(const char* s, std::streamsize n)
+	{
+		Reserve(size_t(n));
+		memcpy(pptr(), s, size_t(n));
+		pbump(int(n));
+		return n;
+	}
+
+private:
+	static const size_t INITIAL_SIZE = 256;
+	static const size_t MAX_RETAINED_SIZE = 64 * 1024;
+
+	// 保证还能写入 count 个字符
+	void Reserve(size_t count)
+	{
+		size_t size = Size();
+		if( size + count <= buffer.size() )
+			return;
+		buffer.resize(std::max(buffer.size() * 2, size + count));
+		setp(&buffer[0], &buffer[0] + buffer.size());
+		pbump(int(size));
+	}
+
+	std::vector<char> buffer;
+};
+
+// 日志时间戳的格式化，缓存当前秒的日期时间文本，同一秒内只改写秒以下的数字
+class TimestampFormatter
+{
+public:
+	// 格式化缓冲区的大小，通常的文本形如“YYYY-MM-DD HH:MM:SS.ffffff”，为异常的年份留出余量
+	static const size_t MAX_SIZE = 80;
+
+	TimestampFormatter() : cached_second(-1), cached_size(0)
+	{
+	}
+
+	// 把当前时间格式化到 out 中，返回文本的长度
+	size_t Format(char* out, int precision)
+	{
+		long long now = boost::chrono::duration_cast<boost::chrono::microseconds>(
+			boost::chrono::system_clock::now().time_since_epoch()).count();
+		long long second = now / 1000000;
+		int fraction = int(now % 1000000);
+		if( second != cached_second ) {
+			time_t t = time_t(second);
+			tm tmp;
+#if defined(WIN32) || defined(_WINDOWS)
+			localtime_s(&tmp, &t);
+#else
+			localtime_r(&t, &tmp);
+#endif
+			cached_size = size_t(sprintf(cached_text, "%04d-%02d-%02d %02d:%02d:%02d", tmp.tm_year+1900,
+				tmp.tm_mon+1, tmp.tm_mday, tmp.tm_hour, tmp.tm_min, tmp.tm_sec));
+			cached_second = second;
+		}
+
+		memcpy(out, cached_text, cached_size);
+		size_t size = cached_size;
+		if( precision <= 0 )
+			return size;
+		if( precision > LOG_TIME_MICROSECOND )
+			precision = LOG_TIME_MICROSECOND;
+		for( int i = precision; i < LOG_TIME_MICROSECOND; i++ )
+			fraction /= 10;
+		out[size++] = '.';
+		for( int i = precision - 1; i >= 0; i-- ) {
+			out[size + i] = char('0' + fraction % 10);
+			fraction /= 10;
+		}
+		return size + precision;
+	}
+
+private:
+	long long cached_second;
+	size_t cached_size;
+	char cached_text[MAX_SIZE];
+};
+
+// 线程的日志消息缓冲区栈，格式化过程中嵌套输出的日志依次使用下一个缓冲区
+struct LoggingStreamCache
+{
+	LoggingStreamCache() : depth(0)
+	{
+	}
+
+	~LoggingStreamCache()
+	{
+		for( size_t i = 0; i < streams.size(); i++ )
+			delete streams[i];
+	}
+
+	std::vector<LoggingStream*> streams;
+	size_t depth;
+	TimestampFormatter timestamp;
+};
+
+static FM_THREAD_LOCAL LoggingStreamCache* t_streamCache = NULL;
+
+static void DeleteStreamCache(LoggingStreamCache* cache)
+{
+	if( cache == t_streamCache )
+		t_streamCache = NULL;
+	delete cache;
+}
+
+static boost::thread_specific_ptr<LoggingStreamCache> stream_cache_owner(&DeleteStreamCache);
+
+static LoggingStream* AcquireStream()
+{
+	LoggingStreamCache* cache = t_streamCache;
+	if( cache == NULL ) {
+		cache = new LoggingStreamCache();
+		stream_cache_owner.reset(cache);
+		t_streamCache = cache;
+	}
+	if( cache->depth == cache->streams.size() )
+		cache->streams.push_back(new LoggingStream());
+	LoggingStream* stream = cache->streams[cache->depth++];
+	stream->Reset();
+	return stream;
+}
+
+static void ReleaseStream()
+{
+	t_streamCache->depth--;
+}
+
+LoggingMessage::LoggingMessage(const char* name, int severity) : log_severity(severity), log_name(name), log_stream(AcquireStream())
 {
 }
 
 LoggingMessage::~LoggingMessage()
 {
 	LoggingSystem& logging_system = GetLoggingSystem();
-	// 析构时输出日志
-	if( log_name == NULL && logging_system.default_logging != NULL )
-		logging_system.default_logging->Log(*this);
-	else {
-		if( log_name != NULL ) {
-			// 找到指定名字的日志
-			std::map<std::string, LoggingImpl*>::iterator it = logging_system.loggings.find(log_name);
-			if( it != logging_system.loggings.end() )
-				it->second->Log(*this);
-		} else {
+	// 析构时输出日志，找到指定名字的日志或默认日志
+	LoggerSlot* slot = (log_name == NULL) ? logging_system.default_logging.load() : logging_system.loggings.Find(log_name);
+	LoggingImpl* impl = NULL;
+	if( slot != NULL ) {
+		impl = slot->Enter();
+		if( impl != NULL )
+			impl->Log(*this);
+		slot->Leave();
+	}
+	if( impl == NULL ) {
+		if( log_name == NULL ) {
 			// 未创建日志文件时直接输出到标准流中
 			if( log_severity <= SEV_ERROR )
-				std::cerr<<log_stream.str();
+				std::cerr.write(Text(), TextSize());
 			else
-				std::cout<<log_stream.str();
+				std::cout.write(Text(), TextSize());
 #if (defined(WIN32) || defined(_WINDOWS)) && defined(_DEBUG)
-			::OutputDebugStringA(log_stream.str().c_str());
+			::OutputDebugStringA(std::string(Text(), TextSize()).c_str());
 #endif
 		}
 	}
+	ReleaseStream();
 }
 
-std::ostringstream& LoggingMessage::Stream(bool header)
+std::ostream& LoggingMessage::Stream(bool header)
 {
 	if( !header )
-		return log_stream;
+		return log_stream->stream;
 
 	// 输出日志记录的时间信息和类型信息
 	static const char SeverityName[][8] = {"FATAL  ", "ERROR  ", "WARNING", "INFO   ", "DEBUG  "};
-	log_stream<<Time::Now().FormatString()<<" "<<SeverityName[log_severity]<<": ";
-	return log_stream;
+	char prefix[TimestampFormatter::MAX_SIZE + 16];
+	size_t size = t_streamCache->timestamp.Format(prefix, Logging::TimestampPrecision());
+	prefix[size++] = ' ';
+	memcpy(prefix + size, SeverityName[log_severity], 7);
+	size += 7;
+	prefix[size++] = ':';
+	prefix[size++] = ' ';
+	log_stream->stream.write(prefix, std::streamsize(size));
+	return log_stream->stream;
+}
+
+const char* LoggingMessage::Text() const
+{
+	return log_stream->Data();
+}
+
+size_t LoggingMessage::TextSize() const
+{
+	return log_stream->Size();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -12,6 +12,25 @@ const int SEV_WARNING          = 2;     /**< 警告级别     */
 const int SEV_INFO             = 3;     /**< 信息级别     */
 const int SEV_DEBUG            = 4;     /**< 调试级别     */
 
+/**
+ * @brief 编译期保留的日志级别。
+ *
+ * 严重级别数值大于该值的 LOG 系列日志在编译期被去除，消息参数也不会被求值。默认在调试版本中
+ * 保留全部级别（SEV_DEBUG），在发布版本中保留到 SEV_INFO。可在编译选项中定义该宏改变默认值。
+ * 被去除的级别无法再通过 Logging::Severity() 或 Logging::SetSeverity() 在运行时打开。
+ */
+#ifndef FM_LOG_MIN_SEVERITY
+#ifdef _DEBUG
+#define FM_LOG_MIN_SEVERITY 4
+#else
+#define FM_LOG_MIN_SEVERITY 3
+#endif
+#endif
+
+const int LOG_TIME_SECOND      = 0;     /**< 日志时间精确到秒   */
+const int LOG_TIME_MILLISECOND = 3;     /**< 日志时间精确到毫秒 */
+const int LOG_TIME_MICROSECOND = 6;     /**< 日志时间精确到微秒 */
+
 const int LOG_NAME_COMPUTER    = 0x01;  /**< 日志名中包含计算机名   */
 const int LOG_NAME_USER        = 0x02;  /**< 日志名中包含用户名     */
 const int LOG_NAME_TIMESTAMP   = 0x04;  /**< 日志名中包含时间戳     */
@@ -19,6 +38,8 @@ const int LOG_IGNORE_LISTENER  = 0x08;  /**< 日志输出忽略侦听器     */
 const int LOG_NO_FILE_CREATED  = 0x10;  /**< 不创建日志文件         */
 const int LOG_STD_STREAM       = 0x20;  /**< 同时输出日志到标准流   */
 const int LOG_ENABLE_BUFFER    = 0x40;  /**< 允许日志输出时使用缓冲 */
+const int LOG_ASYNC            = 0x80;  /**< 由后台线程异步输出日志 */
+const int LOG_ASYNC_DROP       = 0x100; /**< 异步缓冲区满时丢弃日志 */
 
 /**
  * @brief 日志侦听器接口。
@@ -37,6 +58,21 @@ public:
 	 * @param msg 日志消息文本。
      */
 	virtual void Log(const char* name, int severity, const std::string& msg) = 0;
+
+	/**
+	 * @brief 记录日志，日志文本以指针和长度的形式传入，只在调用期间有效。
+     * 
+	 * @param name 日志的名称。
+	 * @param severity 日志严重级别。
+	 * @param text 日志消息文本（不以 0 结尾）。
+	 * @param size 日志消息文本的长度。
+	 * @note 默认实现构造 std::string 后调用 Log(name, severity, msg)。不需要保存日志文本的侦听器
+	 *       可重载该方法，避免每条日志的内存分配。
+     */
+	virtual void Log(const char* name, int severity, const char* text, size_t size)
+	{
+		Log(name, severity, std::string(text, size));
+	}
 };
 
 /**
@@ -69,6 +105,12 @@ public:
 	 * - LogIgnoreListener  = 0x08： 日志输出忽略侦听器
 	 * - LogNoFileCreated   = 0x10： 不创建日志文件
 	 * - LogStdStream       = 0x20： 同时输出日志到标准流
+	 * - LogEnableBuffer    = 0x40： 允许日志输出时使用缓冲
+	 * - LogAsync           = 0x80： 由后台线程异步输出日志。写日志的线程只把日志追加到本线程的无锁缓冲区，
+	 *                               后台线程定期成批写入文件并通知侦听器。同一线程的日志保持先后顺序
+	 * - LogAsyncDrop       = 0x100：异步缓冲区已满时丢弃日志并计数（见 DroppedCount()），默认阻塞等待
+	 * .
+	 * 异步模式下，严重错误级别的日志以及 Flush()、Shutdown() 会等待缓冲区中的日志全部写出。
      */
 	static void Init(const char* name, const char* path = NULL, int config = LOG_NAME_COMPUTER|LOG_NAME_USER, int rollover = 8);
 
@@ -76,6 +118,7 @@ public:
 	 * @brief 安装自定义的日志侦听器。
      * 
 	 * @param listener 日志侦听器接口。
+	 * @note 侦听器中可以输出日志，这些日志只写入文件和标准流，不会再发送给侦听器。
      */
 	static void InstallListener(LoggingListener* listener);
 
@@ -93,6 +136,53 @@ public:
      */
 	static int& Severity();
 
+	/**
+	 * @brief 设置指定日志的严重级别。
+     * 
+	 * @param name 日志的名称，为 NULL 时设置全局的日志严重级别。
+	 * @param severity 日志严重级别，小于 0 时取消该日志的设置，恢复使用全局的日志严重级别。
+	 * @note 可以在日志创建之前设置。只能在编译期保留的级别内调整：发布版本默认在编译期去除了
+	 *       调试级别的日志，需要在运行时为某个子系统打开调试日志时，应以 -DFM_LOG_MIN_SEVERITY=4 编译。
+     */
+	static void SetSeverity(const char* name, int severity);
+
+	/**
+	 * @brief 获取指定日志实际使用的严重级别。
+     * 
+	 * @param name 日志的名称，为 NULL 时表示默认日志。
+	 * @return 该日志单独设置的严重级别，未设置时返回全局的日志严重级别。
+     */
+	static int GetSeverity(const char* name);
+
+	/**
+	 * @brief 判断指定级别的日志是否需要输出。
+     * 
+	 * @param name 日志的名称，为 NULL 时表示默认日志。
+	 * @param severity 日志严重级别。
+	 * @return 需要输出时返回 true。
+     */
+	static bool IsEnabled(const char* name, int severity);
+
+	/**
+	 * @brief 获取或修改日志消息头中时间戳的精度。
+     * 
+	 * @return 秒以下的小数位数的引用，可取 LOG_TIME_SECOND（默认）、LOG_TIME_MILLISECOND 或 LOG_TIME_MICROSECOND。
+	 * @note 每个线程缓存当前秒的日期时间文本，同一秒内的日志只需改写秒以下的数字。
+     */
+	static int& TimestampPrecision();
+
+	/**
+	 * @brief 等待异步缓冲区中已有的日志全部写出。
+     */
+	static void Flush();
+
+	/**
+	 * @brief 获取异步模式下因缓冲区已满而丢弃的日志条数。
+     * 
+	 * @return 自程序启动以来丢弃的日志条数。
+     */
+	static long long DroppedCount();
+
 	/**
 	 * @brief 关闭日志系统。
 	 * 
@@ -107,6 +197,8 @@ private:
 	~Logging();
 };
 
+class LoggingStream;
+
 /**
  * @brief 日志消息。
  *
@@ -128,6 +220,9 @@ private:
  * - DLOG_ERROR
  * - DLOG_CHECK
  * - ......
+ * .
+ * 日志消息格式化到当前线程可复用的缓冲区中，输出时以指针和长度的形式传给日志文件和侦听器，
+ * 通常不需要任何内存分配。格式化过程中嵌套输出的日志使用各自的缓冲区。
  */
 class LIB_SDK LoggingMessage
 {
@@ -158,7 +253,21 @@ public:
 	 * @param header 是否自动生成日志消息的时间戳。
 	 * @return 序列化日志消息的流。
      */
-	std::ostringstream& Stream(bool header = true);
+	std::ostream& Stream(bool header = true);
+
+	/**
+	 * @brief 获取已格式化的日志文本，在消息析构前有效。
+     * 
+	 * @return 日志文本的起始地址（不以 0 结尾）。
+     */
+	const char* Text() const;
+
+	/**
+	 * @brief 获取已格式化的日志文本的长度。
+     * 
+	 * @return 日志文本的字节数。
+     */
+	size_t TextSize() const;
 
 	/**
 	 * @brief 获取日志消息严重级别。
@@ -168,9 +277,12 @@ public:
 	inline int Severity() const { return log_severity; }
 
 private:
+	LoggingMessage(const LoggingMessage&);
+	LoggingMessage& operator=(const LoggingMessage&);
+
 	int                log_severity;
 	const char*        log_name;
-	std::ostringstream log_stream;
+	LoggingStream*     log_stream;
 };
 
 /**
@@ -191,10 +303,10 @@ private:
 	Timer timer;
 };
 
-#define LOG(name, severity, msg)                                              \
-	do {                                                                      \
-		if( severity <= ::fm::Logging::Severity() )                        \
-			::fm::LoggingMessage(name, severity).Stream()<<msg<<std::endl; \
+#define LOG(name, severity, msg)                                                               \
+	do {                                                                                       \
+		if( (severity) <= FM_LOG_MIN_SEVERITY && ::fm::Logging::IsEnabled(name, severity) ) \
+			::fm::LoggingMessage(name, severity).Stream()<<msg<<std::endl;                  \
 	}while(0)
 #define PLOG(name, severity, msg) LOG(name, severity, msg<<": "<<strerror(errno))
 
@@ -0,0 +1,456 @@
+﻿#ifndef _FM_SDK_PARALLEL_ALGORITHM_H_
+#define _FM_SDK_PARALLEL_ALGORITHM_H_
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <boost/atomic.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "SystemExport.h"
+#include "ThreadPool.h"
+
+namespace fm {
+
+namespace detail {
+
+// 每个线程平均分得的块数，块数越多负载越均衡，但调度开销越大
+const size_t PARALLEL_CHUNKS_PER_THREAD = 8;
+
+// 并行排序时每块的最小元素个数，更小的块直接串行排序更快
+const size_t PARALLEL_SORT_MIN_CHUNK = 4096;
+
+// 一次并行调用的共享状态：未完成的任务数以及第一个捕获到的异常
+class ParallelContext
+{
+public:
+	explicit ParallelContext(long pending = 1) : m_pending(pending), m_waiters(0), m_failed(false) { }
+
+	void AddPending()
+	{
+		m_pending.fetch_add(1, boost::memory_order_relaxed);
+	}
+
+	void Done()
+	{
+		if (m_pending.fetch_sub(1, boost::memory_order_acq_rel) == 1)
+		{
+			boost::atomic_thread_fence(boost::memory_order_seq_cst);
+			if (m_waiters.load(boost::memory_order_relaxed) > 0)
+			{
+				boost::unique_lock<boost::mutex> lock(m_mutex);
+				m_condition.notify_all();
+			}
+		}
+	}
+
+	// 等待所有任务完成。等待期间在当前线程中执行线程池中排队的任务，线程池内部线程嵌套调用时
+	// 不会因为所有线程都在等待而死锁；没有可执行的任务时，未完成的任务都在其它线程中执行，此时才挂起
+	void Wait(ThreadPool* pool)
+	{
+		while (m_pending.load(boost::memory_order_acquire) != 0)
+		{
+			if (pool->RunPendingTask())
+				continue;
+
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			m_waiters.fetch_add(1);
+			boost::atomic_thread_fence(boost::memory_order_seq_cst);
+			while (m_pending.load(boost::memory_order_acquire) != 0)
+				m_condition.wait(lock);
+			m_waiters.fetch_sub(1);
+		}
+	}
+
+	bool Failed() const
+	{
+		return m_failed.load(boost::memory_order_relaxed);
+	}
+
+	void SetException(const boost::exception_ptr& e)
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		if (!m_exception)
+			m_exception = e;
+		m_failed.store(true, boost::memory_order_relaxed);
+	}
+
+	void RethrowIfFailed()
+	{
+		if (m_exception)
+			boost::rethrow_exception(m_exception);
+	}
+
+private:
+	boost::atomic<long> m_pending;
+	boost::atomic<int> m_waiters;
+	boost::atomic<bool> m_failed;
+	boost::mutex m_mutex;
+	boost::condition_variable m_condition;
+	boost::exception_ptr m_exception;
+};
+
+typedef boost::shared_ptr<ParallelContext> ParallelContextPtr;
+
+// 处理 [begin, end) 范围内的块：范围大于一块时对半拆分，后一半作为新任务提交，
+// 前一半继续在当前线程拆分，直到只剩一块时执行
+template<typename Body>
+class ParallelChunkTask : public ThreadTask
+{
+public:
+	ParallelChunkTask(const ParallelContextPtr& ctx, ThreadPool* pool, Body* body, size_t begin, size_t end)
+		: m_ctx(ctx), m_pool(pool), m_body(body), m_begin(begin), m_end(end)
+	{
+	}
+
+	void Execute()
+	{
+		Run();
+		m_ctx->Done();
+	}
+
+	// 线程池终止时未执行的块以 OperationCanceledException 结束，等待线程不会永远阻塞
+	void Cancel()
+	{
+		m_ctx->SetException(boost::copy_exception(OperationCanceledException("Parallel task was cancelled before it ran.")));
+		m_ctx->Done();
+	}
+
+private:
+	void Run()
+	{
+		while (m_end - m_begin > 1)
+		{
+			size_t mid = m_begin + (m_end - m_begin) / 2;
+			m_ctx->AddPending();
+			ThreadTaskPtr task = MakeTask<ParallelChunkTask>(m_ctx, m_pool, m_body, mid, m_end);
+			if (m_pool->PushTask(task) == TASK_PUSH_FULL)
+				task->Execute();
+			m_end = mid;
+		}
+
+		if (m_ctx->Failed())
+			return;
+
+		try
+		{
+			(*m_body)(m_begin);
+		}
+		catch (...)
+		{
+			m_ctx->SetException(boost::current_exception());
+		}
+	}
+
+	ParallelContextPtr m_ctx;
+	ThreadPool* m_pool;
+	Body* m_body;
+	size_t m_begin;
+	size_t m_end;
+};
+
+// 在线程池中并行执行 body(0) ... body(chunks-1)，调用线程参与执行并等待全部完成
+template<typename Body>
+void ParallelRun(ThreadPool* pool, size_t chunks, Body& body)
+{
+	if (chunks == 0)
+		return;
+
+	if (chunks == 1 || pool->GetThreadNum() <= 1)
+	{
+		for (size_t i = 0; i < chunks; i++)
+			body(i);
+		return;
+	}
+
+	ParallelContextPtr ctx(new ParallelContext());
+	ParallelChunkTask<Body> root(ctx, pool, &body, 0, chunks);
+	root.Execute();
+	ctx->Wait(pool);
+	ctx->RethrowIfFailed();
+}
+
+// 计算块大小：grain 为 0 时按线程数自适应，保证每个线程约有 PARALLEL_CHUNKS_PER_THREAD 块
+inline size_t ParallelGrain(ThreadPool* pool, size_t count, size_t grain)
+{
+	if (grain > 0)
+		return grain;
+	size_t threads = size_t(std::max(pool->GetThreadNum(), 1));
+	grain = count / (threads * PARALLEL_CHUNKS_PER_THREAD);
+	return grain > 0 ? grain : 1;
+}
+
+template<typename Index, typename Func>
+struct ParallelForBody
+{
+	Index first;
+	size_t count, grain;
+	Func* func;
+
+	void operator()(size_t chunk)
+	{
+		size_t begin = chunk * grain;
+		size_t end   = std::min(begin + grain, count);
+		for (size_t i = begin; i < end; i++)
+			(*func)(Index(first + i));
+	}
+};
+
+// 每块的部分结果独立存储并填充到缓存行，避免 std::vector<bool> 按位打包引起的数据竞争和伪共享
+template<typename T>
+struct ParallelReduceSlot
+{
+	explicit ParallelReduceSlot(const T& identity) : value(identity) { }
+
+	T value;
+	char pad[64];
+};
+
+template<typename T, typename Index, typename Func, typename Reduce>
+struct ParallelReduceBody
+{
+	Index first;
+	size_t count, grain;
+	Func* func;
+	Reduce* reduce;
+	std::vector<ParallelReduceSlot<T> >* results;
+
+	void operator()(size_t chunk)
+	{
+		size_t begin = chunk * grain;
+		size_t end   = std::min(begin + grain, count);
+		T value = (*results)[chunk].value;
+		for (size_t i = begin; i < end; i++)
+			value = (*reduce)(value, (*func)(Index(first + i)));
+		(*results)[chunk].value = value;
+	}
+};
+
+template<typename InputIt, typename OutputIt, typename Func>
+struct ParallelTransformBody
+{
+	InputIt first;
+	OutputIt out;
+	size_t count, grain;
+	Func* func;
+
+	void operator()(size_t chunk)
+	{
+		size_t begin = chunk * grain;
+		size_t end   = std::min(begin + grain, count);
+		for (size_t i = begin; i < end; i++)
+			out[i] = (*func)(first[i]);
+	}
+};
+
+template<typename RandomIt, typename Compare>
+struct ParallelSortBody
+{
+	RandomIt first;
+	size_t count, chunks, width;
+	Compare* comp;
+
+	size_t Bound(size_t chunk) const
+	{
+		return chunk >= chunks ? count : count / chunks * chunk + std::min(chunk, count % chunks);
+	}
+
+	// width 为 0 时对单块排序，否则合并两段长度为 width 块的有序序列
+	void operator()(size_t index)
+	{
+		if (width == 0)
+		{
+			std::sort(first + Bound(index), first + Bound(index + 1), *comp);
+			return;
+		}
+		size_t lo  = Bound(index * 2 * width);
+		size_t mid = Bound(index * 2 * width + width);
+		size_t hi  = Bound(index * 2 * width + 2 * width);
+		if (mid < hi)
+			std::inplace_merge(first + lo, first + mid, first + hi, *comp);
+	}
+};
+
+}
+
+/**
+ * @brief 并行执行 func(i)，i 取遍 [first, last)。
+ *
+ * @param pool 执行任务的线程池。
+ * @param first 起始索引。
+ * @param last 结束索引（不包含）。
+ * @param func 对单个索引执行的函数对象。
+ * @param grain 每个任务处理的最少索引个数，为 0 时根据线程数自动确定。
+ * @note 索引范围被划分为若干块，并以递归对半拆分的方式提交到线程池，调用线程也参与执行，
+ *       函数在全部完成后返回。func 中抛出的异常会在调用线程中重新抛出。
+ */
+template<typename Index, typename Func>
+void parallel_for(ThreadPoolPtr pool, Index first, Index last, Func func, size_t grain = 0)
+{
+	if (!(first < last))
+		return;
+
+	detail::ParallelForBody<Index, Func> body;
+	body.first = first;
+	body.count = size_t(last - first);
+	body.grain = detail::ParallelGrain(pool.get(), body.count, grain);
+	body.func  = &func;
+	detail::ParallelRun(pool.get(), (body.count + body.grain - 1) / body.grain, body);
+}
+
+/**
+ * @brief 使用默认线程池并行执行 func(i)，i 取遍 [first, last)。
+ */
+template<typename Index, typename Func>
+void parallel_for(Index first, Index last, Func func)
+{
+	parallel_for(GetDefaultThreadPool(), first, last, func);
+}
+
+/**
+ * @brief 并行归约：计算 reduce(...reduce(identity, func(first))..., func(last-1))。
+ *
+ * @param pool 执行任务的线程池。
+ * @param first 起始索引。
+ * @param last 结束索引（不包含）。
+ * @param identity 归约的单位元。
+ * @param func 对单个索引求值的函数对象。
+ * @param reduce 满足结合律的二元归约函数对象。
+ * @param grain 每个任务处理的最少索引个数，为 0 时根据线程数自动确定。
+ * @return 归约结果。
+ * @note 各块的部分结果按索引顺序合并，因此结果与线程调度无关。
+ */
+template<typename T, typename Index, typename Func, typename Reduce>
+T parallel_reduce(ThreadPoolPtr pool, Index first, Index last, T identity, Func func, Reduce reduce, size_t grain = 0)
+{
+	if (!(first < last))
+		return identity;
+
+	detail::ParallelReduceBody<T, Index, Func, Reduce> body;
+	body.first  = first;
+	body.count  = size_t(last - first);
+	body.grain  = detail::ParallelGrain(pool.get(), body.count, grain);
+	body.func   = &func;
+	body.reduce = &reduce;
+
+	size_t chunks = (body.count + body.grain - 1) / body.grain;
+	std::vector<detail::ParallelReduceSlot<T> > results(chunks, detail::ParallelReduceSlot<T>(identity));
+	body.results = &results;
+	detail::ParallelRun(pool.get(), chunks, body);
+
+	T value = identity;
+	for (size_t i = 0; i < chunks; i++)
+		value = reduce(value, results[i].value);
+	return value;
+}
+
+/**
+ * @brief 使用默认线程池执行并行归约。
+ */
+template<typename T, typename Index, typename Func, typename Reduce>
+T parallel_reduce(Index first, Index last, T identity, Func func, Reduce reduce)
+{
+	return parallel_reduce(GetDefaultThreadPool(), first, last, identity, func, reduce);
+}
+
+/**
+ * @brief 并行变换：*(out+i) = func(*(first+i))。
+ *
+ * @param pool 执行任务的线程池。
+ * @param first 输入序列的起始位置（随机访问迭代器）。
+ * @param last 输入序列的结束位置。
+ * @param out 输出序列的起始位置（随机访问迭代器）。
+ * @param func 变换函数对象。
+ * @param grain 每个任务处理的最少元素个数，为 0 时根据线程数自动确定。
+ * @return 输出序列的结束位置。
+ */
+template<typename InputIt, typename OutputIt, typename Func>
+OutputIt parallel_transform(ThreadPoolPtr pool, InputIt first, InputIt last, OutputIt out, Func func, size_t grain = 0)
+{
+	size_t count = size_t(std::distance(first, last));
+	if (count == 0)
+		return out;
+
+	detail::ParallelTransformBody<InputIt, OutputIt, Func> body;
+	body.first = first;
+	body.out   = out;
+	body.count = count;
+	body.grain = detail::ParallelGrain(pool.get(), count, grain);
+	body.func  = &func;
+	detail::ParallelRun(pool.get(), (count + body.grain - 1) / body.grain, body);
+	return out + count;
+}
+
+/**
+ * @brief 使用默认线程池执行并行变换。
+ */
+template<typename InputIt, typename OutputIt, typename Func>
+OutputIt parallel_transform(InputIt first, InputIt last, OutputIt out, Func func)
+{
+	return parallel_transform(GetDefaultThreadPool(), first, last, out, func);
+}
+
+/**
+ * @brief 并行排序（不稳定）。
+ *
+ * @param pool 执行任务的线程池。
+ * @param first 序列的起始位置（随机访问迭代器）。
+ * @param last 序列的结束位置。
+ * @param comp 比较函数对象。
+ * @note 序列被划分为若干块并行排序，然后逐层两两并行合并。
+ */
+template<typename RandomIt, typename Compare>
+void parallel_sort(ThreadPoolPtr pool, RandomIt first, RandomIt last, Compare comp)
+{
+	size_t count = size_t(last - first);
+	size_t threads = size_t(std::max(pool->GetThreadNum(), 1));
+	size_t chunks = std::min(threads * 2, count / detail::PARALLEL_SORT_MIN_CHUNK);
+	if (chunks <= 1)
+	{
+		std::sort(first, last, comp);
+		return;
+	}
+
+	detail::ParallelSortBody<RandomIt, Compare> body;
+	body.first  = first;
+	body.count  = count;
+	body.chunks = chunks;
+	body.width  = 0;
+	body.comp   = &comp;
+	detail::ParallelRun(pool.get(), chunks, body);
+
+	for (body.width = 1; body.width < chunks; body.width *= 2)
+		detail::ParallelRun(pool.get(), (chunks + 2 * body.width - 1) / (2 * body.width), body);
+}
+
+/**
+ * @brief 按 operator< 并行排序。
+ */
+template<typename RandomIt>
+void parallel_sort(ThreadPoolPtr pool, RandomIt first, RandomIt last)
+{
+	parallel_sort(pool, first, last, std::less<typename std::iterator_traits<RandomIt>::value_type>());
+}
+
+/**
+ * @brief 使用默认线程池并行排序。
+ */
+template<typename RandomIt, typename Compare>
+void parallel_sort(RandomIt first, RandomIt last, Compare comp)
+{
+	parallel_sort(GetDefaultThreadPool(), first, last, comp);
+}
+
+/**
+ * @brief 使用默认线程池按 operator< 并行排序。
+ */
+template<typename RandomIt>
+void parallel_sort(RandomIt first, RandomIt last)
+{
+	parallel_sort(GetDefaultThreadPool(), first, last);
+}
+
+}
+
+#endif
@@ -0,0 +1,168 @@
+﻿#include <deque>
+#include <boost/thread/mutex.hpp>
+#include "Strand.h"
+#include "Exception.h"
+
+namespace fm {
+
+// 一次调度最多连续执行的任务数，之后重新提交到线程池，避免长队列独占工作线程
+const int STRAND_BATCH_SIZE = 64;
+
+// 当前线程正在执行的 Strand，没有时为 NULL
+static FM_THREAD_LOCAL StrandState* t_currentStrand = NULL;
+
+struct StrandState : public boost::enable_shared_from_this<StrandState>
+{
+	explicit StrandState(ThreadPoolPtr pool) : pool(pool), scheduled(false) { }
+
+	// 加入任务，Strand 尚未调度时提交调度任务
+	void Post(ThreadTaskPtr task);
+
+	// 一批任务执行完后，队列非空则重新提交调度任务，否则结束调度
+	void Continue();
+
+	// 向线程池提交调度任务，有界线程池拒绝时直接在当前线程中执行
+	void Schedule();
+
+	// 调度任务被线程池丢弃时取消队列中的所有任务并结束调度
+	void Cancel();
+
+	ThreadPoolPtr pool;
+
+	mutable boost::mutex mutex;
+
+	std::deque<ThreadTaskPtr> tasks;
+
+	// 是否已有调度任务在线程池中排队或执行，保证同一时刻最多只有一个线程执行本 Strand 的任务
+	bool scheduled;
+};
+
+// 调度任务，每次调度依次执行 Strand 队列中的任务
+class StrandRunner : public ThreadTask
+{
+public:
+	explicit StrandRunner(const boost::shared_ptr<StrandState>& state) : state(state) { }
+
+	void Execute()
+	{
+		StrandState* previous = t_currentStrand;
+		t_currentStrand = state.get();
+		for (int i = 0; i < STRAND_BATCH_SIZE; i++)
+		{
+			ThreadTaskPtr task;
+			{
+				boost::unique_lock<boost::mutex> lock(state->mutex);
+				if (state->tasks.empty())
+				{
+					state->scheduled = false;
+					t_currentStrand = previous;
+					return;
+				}
+				task.swap(state->tasks.front());
+				state->tasks.pop_front();
+			}
+
+			try
+			{
+				task->Execute();
+			}
+			catch (...)
+			{
+				// 任务抛出异常时仍需继续调度剩余的任务
+				t_currentStrand = previous;
+				state->Continue();
+				throw;
+			}
+		}
+		t_currentStrand = previous;
+		state->Continue();
+	}
+
+	void Cancel()
+	{
+		state->Cancel();
+	}
+
+private:
+	boost::shared_ptr<StrandState> state;
+};
+
+void StrandState::Post(ThreadTaskPtr task)
+{
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		tasks.push_back(task);
+		if (scheduled)
+			return;
+		scheduled = true;
+	}
+	Schedule();
+}
+
+void StrandState::Continue()
+{
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		if (tasks.empty())
+		{
+			scheduled = false;
+			return;
+		}
+	}
+	Schedule();
+}
+
+void StrandState::Schedule()
+{
+	ThreadTaskPtr runner = MakeTask<StrandRunner>(shared_from_this());
+	if (pool->PushTask(runner) == TASK_PUSH_FULL)
+		runner->Execute();
+}
+
+void StrandState::Cancel()
+{
+	std::deque<ThreadTaskPtr> cancelled;
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		cancelled.swap(tasks);
+		scheduled = false;
+	}
+	for (size_t i = 0; i < cancelled.size(); i++)
+		cancelled[i]->Cancel();
+}
+
+Strand::Strand(ThreadPoolPtr pool)
+{
+	if (!pool)
+		THROW(NullPointerException, "Strand requires a thread pool.");
+	state = boost::make_shared<StrandState>(pool);
+}
+
+Strand::~Strand()
+{
+}
+
+void Strand::Post(ThreadTaskPtr task)
+{
+	if (!task)
+		THROW(NullPointerException, "Strand task is null.");
+	state->Post(task);
+}
+
+bool Strand::RunningInThisThread() const
+{
+	return t_currentStrand == state.get();
+}
+
+size_t Strand::GetPendingCount() const
+{
+	boost::unique_lock<boost::mutex> lock(state->mutex);
+	return state->tasks.size();
+}
+
+ThreadPoolPtr Strand::GetThreadPool() const
+{
+	return state->pool;
+}
+
+}
@@ -0,0 +1,84 @@
+﻿#ifndef _FM_SDK_STRAND_H_
+#define _FM_SDK_STRAND_H_
+
+#include <boost/utility/result_of.hpp>
+#include <boost/make_shared.hpp>
+#include "SystemExport.h"
+#include "ThreadTask.h"
+#include "ThreadPool.h"
+
+namespace fm {
+
+struct StrandState;
+
+/**
+ * @brief 串行执行器。
+ *
+ * 提交到同一个 Strand 的任务按提交顺序逐个执行，但不占用专门的线程：Strand 有任务时只向线程池
+ * 提交一个调度任务，由任意空闲的工作线程依次执行队列中的任务。执行任务时不持有任何锁，
+ * 因此大量 Strand 可以共享一个小线程池，替代在 Execute() 中加锁串行化的做法。
+ * 复制得到的 Strand 对象共享同一个任务队列。
+ * @note 使用示例：
+ * -     Strand strand(pool);
+ * -     strand.Post(MakeFunctionTask(write_func));
+ * -     Future<int> result = strand.Submit(read_func);
+ */
+class LIB_SDK Strand
+{
+public:
+	/**
+	 * @brief 构造函数。
+	 *
+	 * @param pool 执行任务的线程池。
+	 */
+	explicit Strand(ThreadPoolPtr pool);
+
+	/**
+	 * @brief 析构函数。已提交的任务仍会执行完毕。
+	 */
+	~Strand();
+
+	/**
+	 * @brief 提交任务，任务在此前提交的任务全部完成后执行。
+	 *
+	 * @param task 线程任务。
+	 */
+	void Post(ThreadTaskPtr task);
+
+	/**
+	 * @brief 提交可调用对象，并返回其异步结果。
+	 *
+	 * @param func 无参数的可调用对象。
+	 * @return 可用于等待任务完成并获取返回值的 Future 对象。
+	 */
+	template<typename F>
+	Future<typename boost::result_of<F()>::type> Submit(F func)
+	{
+		typedef typename boost::result_of<F()>::type R;
+		boost::shared_ptr<FutureTask<R, F> > task = MakeTask<FutureTask<R, F> >(func);
+		Post(task);
+		return Future<R>(task);
+	}
+
+	/**
+	 * @brief 判断当前线程是否正在执行本 Strand 的任务。
+	 */
+	bool RunningInThisThread() const;
+
+	/**
+	 * @brief 获取尚未开始执行的任务数量。
+	 */
+	size_t GetPendingCount() const;
+
+	/**
+	 * @brief 获取执行任务的线程池。
+	 */
+	ThreadPoolPtr GetThreadPool() const;
+
+private:
+	boost::shared_ptr<StrandState> state;
+};
+
+}
+
+#endif
@@ -14,6 +14,12 @@
 	#define LIB_SDK
 #endif
 
+#if defined(WIN32) || defined(_WINDOWS)
+	#define FM_THREAD_LOCAL __declspec(thread)
+#else
+	#define FM_THREAD_LOCAL __thread
+#endif
+
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
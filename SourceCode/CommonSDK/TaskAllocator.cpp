@@ -0,0 +1,191 @@
+﻿#include <algorithm>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include "TaskAllocator.h"
+
+namespace fm {
+
+// 块大小按 64 字节分级，共 8 级，最大 512 字节
+const size_t TASK_BLOCK_GRANULARITY = 64;
+const size_t TASK_CLASS_COUNT = 8;
+
+// 每个 slab 切分的块数
+const size_t TASK_SLAB_BLOCKS = 64;
+
+// 线程缓存与全局缓存之间每次交换的块数，线程缓存超过两批时归还一批
+const size_t TASK_TRANSFER_BATCH = 64;
+
+struct TaskBlock
+{
+	TaskBlock* next;
+};
+
+struct TaskFreeList
+{
+	TaskFreeList() : head(NULL), count(0) { }
+
+	TaskBlock* head;
+	size_t count;
+};
+
+// 全局缓存，各线程成批归还和领取空闲块。对象有意不释放，线程在静态对象析构后退出时仍可归还
+struct TaskDepot
+{
+	TaskDepot() : slab_count(0), heap_allocations(0) { }
+
+	boost::mutex mutex;
+	TaskFreeList lists[TASK_CLASS_COUNT];
+	boost::atomic<long long> slab_count;
+	boost::atomic<long long> heap_allocations;
+};
+
+static TaskDepot* depot = new TaskDepot();
+
+struct TaskThreadCache
+{
+	~TaskThreadCache();
+
+	TaskFreeList lists[TASK_CLASS_COUNT];
+};
+
+// 当前线程的缓存。线程局部指针用于快速访问，thread_specific_ptr 负责在线程退出时归还空闲块，
+// 与全局缓存一样有意不释放
+static FM_THREAD_LOCAL TaskThreadCache* t_cache = NULL;
+static boost::thread_specific_ptr<TaskThreadCache>* thread_cache = new boost::thread_specific_ptr<TaskThreadCache>();
+
+static inline size_t SizeClass(size_t size)
+{
+	return size == 0 ? 0 : (size - 1) / TASK_BLOCK_GRANULARITY;
+}
+
+// 把 list 开头的 count 个块移入全局缓存，count 为 0 时移入全部
+static void ReturnBlocks(TaskFreeList& list, size_t index, size_t count)
+{
+	if (list.head == NULL)
+		return;
+	if (count == 0 || count > list.count)
+		count = list.count;
+
+	TaskBlock* first = list.head;
+	TaskBlock* last = first;
+	for (size_t i = 1; i < count; i++)
+		last = last->next;
+	list.head = last->next;
+	list.count -= count;
+
+	boost::unique_lock<boost::mutex> lock(depot->mutex);
+	TaskFreeList& shared = depot->lists[index];
+	last->next = shared.head;
+	shared.head = first;
+	shared.count += count;
+}
+
+// 从全局缓存领取一批块，全局缓存为空时分配一个新的 slab
+static void RefillBlocks(TaskFreeList& list, size_t index)
+{
+	{
+		boost::unique_lock<boost::mutex> lock(depot->mutex);
+		TaskFreeList& shared = depot->lists[index];
+		if (shared.head)
+		{
+			size_t count = std::min(shared.count, TASK_TRANSFER_BATCH);
+			TaskBlock* last = shared.head;
+			for (size_t i = 1; i < count; i++)
+				last = last->next;
+			list.head = shared.head;
+			list.count = count;
+			shared.head = last->next;
+			shared.count -= count;
+			last->next = NULL;
+			return;
+		}
+	}
+
+	size_t block_size = (index + 1) * TASK_BLOCK_GRANULARITY;
+	char* slab = static_cast<char*>(::operator new(block_size * TASK_SLAB_BLOCKS));
+	depot->slab_count.fetch_add(1, boost::memory_order_relaxed);
+	for (size_t i = 0; i < TASK_SLAB_BLOCKS; i++)
+	{
+		TaskBlock* block = reinterpret_cast<TaskBlock*>(slab + i * block_size);
+		block->next = list.head;
+		list.head = block;
+	}
+	list.count = TASK_SLAB_BLOCKS;
+}
+
+TaskThreadCache::~TaskThreadCache()
+{
+	for (size_t i = 0; i < TASK_CLASS_COUNT; i++)
+		ReturnBlocks(lists[i], i, 0);
+	t_cache = NULL;
+}
+
+static TaskThreadCache* ThreadCache()
+{
+	TaskThreadCache* cache = t_cache;
+	if (cache == NULL)
+	{
+		cache = new TaskThreadCache();
+		thread_cache->reset(cache);
+		t_cache = cache;
+	}
+	return cache;
+}
+
+TaskAllocatorStats::TaskAllocatorStats()
+	: slab_count(0),
+	  heap_allocations(0),
+	  depot_blocks(0)
+{
+}
+
+void* TaskMemory::Allocate(size_t size)
+{
+	size_t index = SizeClass(size);
+	if (index >= TASK_CLASS_COUNT)
+	{
+		depot->heap_allocations.fetch_add(1, boost::memory_order_relaxed);
+		return ::operator new(size);
+	}
+
+	TaskFreeList& list = ThreadCache()->lists[index];
+	if (list.head == NULL)
+		RefillBlocks(list, index);
+
+	TaskBlock* block = list.head;
+	list.head = block->next;
+	list.count--;
+	return block;
+}
+
+void TaskMemory::Deallocate(void* ptr, size_t size)
+{
+	size_t index = SizeClass(size);
+	if (index >= TASK_CLASS_COUNT)
+	{
+		::operator delete(ptr);
+		return;
+	}
+
+	TaskFreeList& list = ThreadCache()->lists[index];
+	TaskBlock* block = static_cast<TaskBlock*>(ptr);
+	block->next = list.head;
+	list.head = block;
+	if (++list.count >= 2 * TASK_TRANSFER_BATCH)
+		ReturnBlocks(list, index, TASK_TRANSFER_BATCH);
+}
+
+TaskAllocatorStats TaskMemory::GetStats()
+{
+	TaskAllocatorStats stats;
+	stats.slab_count       = depot->slab_count.load(boost::memory_order_relaxed);
+	stats.heap_allocations = depot->heap_allocations.load(boost::memory_order_relaxed);
+
+	boost::unique_lock<boost::mutex> lock(depot->mutex);
+	for (size_t i = 0; i < TASK_CLASS_COUNT; i++)
+		stats.depot_blocks += depot->lists[i].count;
+	return stats;
+}
+
+}
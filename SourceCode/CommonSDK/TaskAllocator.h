@@ -0,0 +1,174 @@
+﻿#ifndef _FM_SDK_TASK_ALLOCATOR_H_
+#define _FM_SDK_TASK_ALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+#include <boost/make_shared.hpp>
+#include "SystemExport.h"
+
+namespace fm {
+
+/**
+ * @brief 任务内存池的统计数据。
+ */
+struct LIB_SDK TaskAllocatorStats
+{
+	TaskAllocatorStats();
+
+	long long slab_count;            /**< 从堆上分配的内存块（slab）数量             */
+	long long heap_allocations;      /**< 超出内存池分级而直接从堆上分配的次数       */
+	long long depot_blocks;          /**< 全局缓存中空闲的块数，不含各线程缓存中的块 */
+};
+
+/**
+ * @brief 线程任务的内存池。
+ *
+ * 内存按 64 字节分级，每次从堆上分配一整个 slab 切分为多个块。每个线程缓存一定数量的空闲块，
+ * 分配和释放只访问本线程的空闲链表；线程缓存过多或用尽时与全局缓存成批交换，
+ * 因此在一个线程中创建、在另一个线程中释放的任务也能循环复用。
+ * @note slab 在进程结束前不会归还给系统。超过 512 字节的请求直接使用 operator new。
+ */
+class LIB_SDK TaskMemory
+{
+public:
+	/**
+	 * @brief 分配内存。
+	 *
+	 * @param size 字节数。
+	 */
+	static void* Allocate(size_t size);
+
+	/**
+	 * @brief 释放由 Allocate 分配的内存。
+	 *
+	 * @param ptr 内存地址。
+	 * @param size 分配时的字节数。
+	 */
+	static void Deallocate(void* ptr, size_t size);
+
+	/**
+	 * @brief 获取内存池的统计数据。
+	 */
+	static TaskAllocatorStats GetStats();
+};
+
+/**
+ * @brief 从任务内存池分配内存的分配器，满足标准库分配器的要求。
+ *
+ * 与 boost::allocate_shared 配合使用时，任务对象与 shared_ptr 的控制块在同一个池化的块中。
+ */
+template<typename T>
+class TaskAllocator
+{
+public:
+	typedef T              value_type;
+	typedef T*             pointer;
+	typedef const T*       const_pointer;
+	typedef T&             reference;
+	typedef const T&       const_reference;
+	typedef size_t         size_type;
+	typedef std::ptrdiff_t difference_type;
+
+	template<typename U>
+	struct rebind
+	{
+		typedef TaskAllocator<U> other;
+	};
+
+	TaskAllocator() { }
+
+	template<typename U>
+	TaskAllocator(const TaskAllocator<U>&) { }
+
+	pointer address(reference value) const
+	{
+		return &value;
+	}
+
+	const_pointer address(const_reference value) const
+	{
+		return &value;
+	}
+
+	pointer allocate(size_type count, const void* = 0)
+	{
+		return static_cast<pointer>(TaskMemory::Allocate(count * sizeof(T)));
+	}
+
+	void deallocate(pointer ptr, size_type count)
+	{
+		TaskMemory::Deallocate(ptr, count * sizeof(T));
+	}
+
+	size_type max_size() const
+	{
+		return size_type(-1) / sizeof(T);
+	}
+
+	void construct(pointer ptr, const T& value)
+	{
+		new (ptr) T(value);
+	}
+
+	void destroy(pointer ptr)
+	{
+		ptr->~T();
+	}
+};
+
+template<typename T, typename U>
+inline bool operator==(const TaskAllocator<T>&, const TaskAllocator<U>&)
+{
+	return true;
+}
+
+template<typename T, typename U>
+inline bool operator!=(const TaskAllocator<T>&, const TaskAllocator<U>&)
+{
+	return false;
+}
+
+/**
+ * @brief 在任务内存池中创建对象，对象与 shared_ptr 控制块只占用一个池化的块
+ *
+ * @return 返回指向新对象的 shared_ptr
+ */
+template<typename T>
+boost::shared_ptr<T> MakeTask()
+{
+	return boost::allocate_shared<T>(TaskAllocator<T>());
+}
+
+template<typename T, typename A1>
+boost::shared_ptr<T> MakeTask(const A1& a1)
+{
+	return boost::allocate_shared<T>(TaskAllocator<T>(), a1);
+}
+
+template<typename T, typename A1, typename A2>
+boost::shared_ptr<T> MakeTask(const A1& a1, const A2& a2)
+{
+	return boost::allocate_shared<T>(TaskAllocator<T>(), a1, a2);
+}
+
+template<typename T, typename A1, typename A2, typename A3>
+boost::shared_ptr<T> MakeTask(const A1& a1, const A2& a2, const A3& a3)
+{
+	return boost::allocate_shared<T>(TaskAllocator<T>(), a1, a2, a3);
+}
+
+template<typename T, typename A1, typename A2, typename A3, typename A4>
+boost::shared_ptr<T> MakeTask(const A1& a1, const A2& a2, const A3& a3, const A4& a4)
+{
+	return boost::allocate_shared<T>(TaskAllocator<T>(), a1, a2, a3, a4);
+}
+
+template<typename T, typename A1, typename A2, typename A3, typename A4, typename A5>
+boost::shared_ptr<T> MakeTask(const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5)
+{
+	return boost::allocate_shared<T>(TaskAllocator<T>(), a1, a2, a3, a4, a5);
+}
+
+}
+
+#endif
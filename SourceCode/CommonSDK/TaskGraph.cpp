@@ -0,0 +1,230 @@
+﻿#include "TaskGraph.h"
+#include "Exception.h"
+
+namespace fm {
+
+// 节点执行器，每个节点创建一次，重复运行时反复提交同一个对象
+class TaskGraphRunner : public ThreadTask
+{
+public:
+	TaskGraphRunner(TaskGraph* graph, int index) : graph(graph), index(index) { }
+
+	void Execute()
+	{
+		graph->Execute(index, false);
+	}
+
+	void Cancel()
+	{
+		graph->Execute(index, true);
+	}
+
+private:
+	TaskGraph* graph;
+
+	int index;
+};
+
+struct TaskGraphNode
+{
+	ThreadTaskPtr task;
+
+	ThreadTaskPtr runner;
+
+	std::vector<int> successors;
+
+	// 前驱数量，以及本次运行中尚未完成的前驱数量
+	int predecessors;
+
+	boost::atomic<int> pending;
+};
+
+TaskGraph::TaskGraph() : remaining(0), running(false), validated(true)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+	{
+		boost::unique_lock<boost::mutex> lock(run_mutex);
+		while (running)
+			run_condition.wait(lock);
+	}
+
+	for (size_t i = 0; i < nodes.size(); i++)
+		delete nodes[i];
+	nodes.clear();
+}
+
+int TaskGraph::AddNode(ThreadTaskPtr task)
+{
+	if (!task)
+		THROW(NullPointerException, "TaskGraph node task is null.");
+	if (IsRunning())
+		THROW(InvalidOperationException, "Cannot modify a running TaskGraph.");
+
+	int index = int(nodes.size());
+	TaskGraphNode* node = new TaskGraphNode();
+	node->task         = task;
+	node->runner       = ThreadTaskPtr(new TaskGraphRunner(this, index));
+	node->predecessors = 0;
+	node->pending.store(0);
+	nodes.push_back(node);
+	return index;
+}
+
+void TaskGraph::AddEdge(int from, int to)
+{
+	if (from < 0 || from >= int(nodes.size()) || to < 0 || to >= int(nodes.size()))
+		THROW(IndexOutOfRangeException, "TaskGraph edge "<<from<<"->"<<to<<" refers to an unknown node.");
+	if (IsRunning())
+		THROW(InvalidOperationException, "Cannot modify a running TaskGraph.");
+
+	nodes[from]->successors.push_back(to);
+	nodes[to]->predecessors++;
+	validated = false;
+}
+
+int TaskGraph::GetNodeCount() const
+{
+	return int(nodes.size());
+}
+
+void TaskGraph::Run(ThreadPoolPtr pool)
+{
+	if (!pool)
+		THROW(NullPointerException, "TaskGraph requires a thread pool.");
+
+	{
+		boost::unique_lock<boost::mutex> lock(run_mutex);
+		if (running)
+			THROW(InvalidOperationException, "TaskGraph is already running.");
+		Validate();
+		if (nodes.empty())
+			return;
+		running = true;
+		run_pool = pool;
+		run_exception = boost::exception_ptr();
+	}
+
+	for (size_t i = 0; i < nodes.size(); i++)
+		nodes[i]->pending.store(nodes[i]->predecessors, boost::memory_order_relaxed);
+	remaining.store(int(nodes.size()), boost::memory_order_release);
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		// 有界线程池拒绝任务时直接在当前线程中执行
+		if (nodes[i]->predecessors == 0 && pool->PushTask(nodes[i]->runner) == TASK_PUSH_FULL)
+			nodes[i]->runner->Execute();
+	}
+}
+
+void TaskGraph::Wait()
+{
+	boost::unique_lock<boost::mutex> lock(run_mutex);
+	while (running)
+		run_condition.wait(lock);
+
+	if (run_exception)
+	{
+		boost::exception_ptr e = run_exception;
+		run_exception = boost::exception_ptr();
+		boost::rethrow_exception(e);
+	}
+}
+
+void TaskGraph::RunAndWait(ThreadPoolPtr pool)
+{
+	Run(pool);
+	Wait();
+}
+
+bool TaskGraph::IsRunning() const
+{
+	boost::unique_lock<boost::mutex> lock(run_mutex);
+	return running;
+}
+
+// 使用拓扑排序检查依赖图中是否存在环，只在图结构改变后检查一次
+void TaskGraph::Validate()
+{
+	if (validated)
+		return;
+
+	std::vector<int> indegree(nodes.size());
+	std::vector<int> ready;
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		indegree[i] = nodes[i]->predecessors;
+		if (indegree[i] == 0)
+			ready.push_back(int(i));
+	}
+
+	size_t visited = 0;
+	while (!ready.empty())
+	{
+		int index = ready.back();
+		ready.pop_back();
+		visited++;
+
+		const std::vector<int>& successors = nodes[index]->successors;
+		for (size_t i = 0; i < successors.size(); i++)
+		{
+			if (--indegree[successors[i]] == 0)
+				ready.push_back(successors[i]);
+		}
+	}
+
+	if (visited != nodes.size())
+		THROW(InvalidOperationException, "TaskGraph contains a dependency cycle.");
+	validated = true;
+}
+
+void TaskGraph::Execute(int index, bool cancelled)
+{
+	while (index >= 0)
+	{
+		TaskGraphNode* node = nodes[index];
+		try
+		{
+			// 节点任务被线程池丢弃时不再执行，当前线程中继续执行的后继节点同样跳过，
+			// 但仍然完成依赖计数，使 Wait() 能够返回
+			if (cancelled)
+				throw OperationCanceledException("TaskGraph node was cancelled before it ran.");
+			node->task->Execute();
+		}
+		catch (...)
+		{
+			boost::unique_lock<boost::mutex> lock(run_mutex);
+			if (!run_exception)
+				run_exception = boost::current_exception();
+		}
+
+		// 提交就绪的后继节点，最后一个就绪的后继直接在当前线程中继续执行
+		int next = -1;
+		for (size_t i = 0; i < node->successors.size(); i++)
+		{
+			int successor = node->successors[i];
+			if (nodes[successor]->pending.fetch_sub(1, boost::memory_order_acq_rel) == 1)
+			{
+				if (next >= 0 && run_pool->PushTask(nodes[next]->runner) == TASK_PUSH_FULL)
+					nodes[next]->runner->Execute();
+				next = successor;
+			}
+		}
+
+		if (remaining.fetch_sub(1, boost::memory_order_acq_rel) == 1)
+			Finish();
+		index = next;
+	}
+}
+
+void TaskGraph::Finish()
+{
+	boost::unique_lock<boost::mutex> lock(run_mutex);
+	running = false;
+	run_pool.reset();
+	run_condition.notify_all();
+}
+
+}
@@ -0,0 +1,121 @@
+﻿#ifndef _FM_SDK_TASK_GRAPH_H_
+#define _FM_SDK_TASK_GRAPH_H_
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/exception_ptr.hpp>
+#include "SystemExport.h"
+#include "ThreadTask.h"
+#include "ThreadPool.h"
+
+namespace fm {
+
+struct TaskGraphNode;
+
+/**
+ * @brief 任务依赖图。
+ *
+ * TaskGraph 由若干任务节点和节点之间的依赖边组成。运行时，所有前驱都已完成的节点会
+ * 立即提交到线程池，节点的就绪状态由原子计数器维护，不需要为每条边加锁。
+ * 任务图可以重复运行，再次运行时只重置计数器，不会重新分配节点。
+ * @note 使用示例：
+ * -     TaskGraph graph;
+ * -     int load = graph.AddNode(load_task);
+ * -     int parse = graph.AddNode(MakeFunctionTask(parse_func));
+ * -     graph.AddEdge(load, parse);
+ * -     graph.RunAndWait(pool);
+ */
+class LIB_SDK TaskGraph
+{
+public:
+	/**
+	 * @brief 构造函数。
+	 */
+	TaskGraph();
+
+	/**
+	 * @brief 析构函数，若任务图仍在运行则等待其结束。
+	 */
+	~TaskGraph();
+
+	/**
+	 * @brief 添加任务节点。
+	 *
+	 * @param task 节点执行的线程任务。
+	 * @return 节点编号，用于添加依赖边。
+	 */
+	int AddNode(ThreadTaskPtr task);
+
+	/**
+	 * @brief 添加依赖边，节点 to 在节点 from 完成之后才会执行。
+	 *
+	 * @param from 前驱节点编号。
+	 * @param to 后继节点编号。
+	 */
+	void AddEdge(int from, int to);
+
+	/**
+	 * @brief 获取节点的数量。
+	 */
+	int GetNodeCount() const;
+
+	/**
+	 * @brief 在指定线程池中启动任务图，立即返回。
+	 *
+	 * @param pool 执行任务的线程池。
+	 * @note 任务图存在环时抛出 InvalidOperationException；上一次运行尚未结束时同样抛出该异常。
+	 */
+	void Run(ThreadPoolPtr pool);
+
+	/**
+	 * @brief 等待任务图运行结束。
+	 *
+	 * @note 若有节点在执行中抛出异常，则在此处重新抛出第一个异常。出错节点的后继仍会执行。
+	 */
+	void Wait();
+
+	/**
+	 * @brief 启动任务图并等待其运行结束。
+	 *
+	 * @param pool 执行任务的线程池。
+	 */
+	void RunAndWait(ThreadPoolPtr pool);
+
+	/**
+	 * @brief 判断任务图是否正在运行。
+	 */
+	bool IsRunning() const;
+
+private:
+	friend class TaskGraphRunner;
+
+	TaskGraph(const TaskGraph&);
+	TaskGraph& operator=(const TaskGraph&);
+
+	void Validate();
+
+	void Execute(int index, bool cancelled);
+
+	void Finish();
+
+	std::vector<TaskGraphNode*> nodes;
+
+	ThreadPoolPtr run_pool;
+
+	boost::atomic<int> remaining;
+
+	bool running;
+
+	bool validated;
+
+	mutable boost::mutex run_mutex;
+
+	boost::condition_variable run_condition;
+
+	boost::exception_ptr run_exception;
+};
+
+}
+
+#endif
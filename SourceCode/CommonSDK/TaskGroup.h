@@ -0,0 +1,172 @@
+﻿#ifndef _FM_SDK_TASK_GROUP_H_
+#define _FM_SDK_TASK_GROUP_H_
+
+#include <boost/type_traits/is_convertible.hpp>
+#include <boost/utility/enable_if.hpp>
+#include "SystemExport.h"
+#include "ThreadTask.h"
+#include "ThreadPool.h"
+#include "ParallelAlgorithm.h"
+
+namespace fm {
+
+namespace detail {
+
+// 执行 ThreadTask 的函数对象，使 TaskGroup::Spawn(ThreadTaskPtr) 与可调用对象共用同一个包装任务
+struct TaskGroupExecute
+{
+	explicit TaskGroupExecute(ThreadTaskPtr task) : task(task) { }
+
+	void operator()()
+	{
+		task->Execute();
+	}
+
+	ThreadTaskPtr task;
+};
+
+// TaskGroup 提交的任务：任务组已失败时不再执行，完成后减少任务组的未完成计数
+template<typename F>
+class TaskGroupTask : public ThreadTask
+{
+public:
+	TaskGroupTask(const ParallelContextPtr& ctx, const F& func) : m_ctx(ctx), m_func(func) { }
+
+	void Execute()
+	{
+		if (!m_ctx->Failed())
+		{
+			try
+			{
+				m_func();
+			}
+			catch (...)
+			{
+				m_ctx->SetException(boost::current_exception());
+			}
+		}
+		m_ctx->Done();
+	}
+
+	void Cancel()
+	{
+		m_ctx->SetException(boost::copy_exception(OperationCanceledException("TaskGroup task was cancelled before it ran.")));
+		m_ctx->Done();
+	}
+
+private:
+	ParallelContextPtr m_ctx;
+	F m_func;
+};
+
+}
+
+/**
+ * @brief 分叉-合并任务组。
+ *
+ * Spawn 将子任务提交到线程池，Sync 等待所有子任务完成。等待期间当前线程会执行线程池中
+ * 排队的任务（优先执行本线程刚提交的子任务），而不是挂起，因此任务在 Execute() 中递归
+ * 创建任务组并等待（如四叉树构建、归并排序）时，固定大小的线程池也不会死锁。
+ * @note 使用示例：
+ * -     void Build(Node* node)
+ * -     {
+ * -         TaskGroup group(pool);
+ * -         for (int i = 0; i < 4; i++)
+ * -             group.Spawn(boost::bind(&Build, node->children[i]));
+ * -         group.Sync();
+ * -     }
+ */
+class TaskGroup
+{
+public:
+	/**
+	 * @brief 构造函数，使用默认线程池。
+	 */
+	TaskGroup() : m_pool(GetDefaultThreadPool())
+	{
+		Reset();
+	}
+
+	/**
+	 * @brief 构造函数。
+	 *
+	 * @param pool 执行子任务的线程池。
+	 */
+	explicit TaskGroup(ThreadPoolPtr pool) : m_pool(pool)
+	{
+		if (!m_pool)
+			THROW(NullPointerException, "TaskGroup requires a thread pool.");
+		Reset();
+	}
+
+	/**
+	 * @brief 析构函数，等待尚未完成的子任务，忽略子任务抛出的异常。
+	 */
+	~TaskGroup()
+	{
+		m_ctx->Wait(m_pool.get());
+	}
+
+	/**
+	 * @brief 提交子任务。
+	 *
+	 * @param task 线程任务。
+	 */
+	void Spawn(ThreadTaskPtr task)
+	{
+		Spawn(detail::TaskGroupExecute(task));
+	}
+
+	/**
+	 * @brief 提交可调用对象作为子任务。
+	 *
+	 * @param func 无参数的可调用对象。
+	 */
+	template<typename F>
+	typename boost::disable_if<boost::is_convertible<F, ThreadTaskPtr> >::type Spawn(F func)
+	{
+		m_ctx->AddPending();
+		ThreadTaskPtr task = MakeTask<detail::TaskGroupTask<F> >(m_ctx, func);
+		if (m_pool->PushTask(task) == TASK_PUSH_FULL)
+			task->Execute();
+	}
+
+	/**
+	 * @brief 等待所有已提交的子任务完成，等待期间帮助执行线程池中的任务。
+	 *
+	 * @note 任一子任务抛出异常时，尚未开始的子任务不再执行，Sync 重新抛出第一个异常。
+	 *       Sync 返回后任务组可以继续使用。
+	 */
+	void Sync()
+	{
+		m_ctx->Wait(m_pool.get());
+		detail::ParallelContextPtr ctx = m_ctx;
+		Reset();
+		ctx->RethrowIfFailed();
+	}
+
+	/**
+	 * @brief 获取执行子任务的线程池。
+	 */
+	ThreadPoolPtr GetThreadPool() const
+	{
+		return m_pool;
+	}
+
+private:
+	TaskGroup(const TaskGroup&);
+	TaskGroup& operator=(const TaskGroup&);
+
+	void Reset()
+	{
+		m_ctx.reset(new detail::ParallelContext(0));
+	}
+
+	ThreadPoolPtr m_pool;
+
+	detail::ParallelContextPtr m_ctx;
+};
+
+}
+
+#endif
@@ -1,198 +1,2041 @@
-﻿#include <boost/thread.hpp>
+﻿#if defined(WIN32) || defined(_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <typeinfo>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/core/demangle.hpp>
 #include "ThreadPool.h"
+#include "LockFreeQueue.h"
+#include "ExecutionContext.h"
 #include "Logging.h"
 
 namespace fm
 {
 
 class WorkThread;
+struct WorkerQueue;
+struct NodeQueue;
+struct TaskEntry;
 typedef boost::shared_ptr<boost::thread> ThreadPtr;
-typedef std::list<ThreadTaskPtr>         TaskList;
+typedef std::list<TaskEntry>             TaskList;
 typedef boost::shared_ptr<WorkThread>    WorkThreadPtr;
 typedef std::vector<WorkThreadPtr>       WorkThreadVec;
+typedef boost::shared_ptr<WorkerQueue>   WorkerQueuePtr;
+typedef std::vector<WorkerQueuePtr>      WorkerQueueVec;
+typedef boost::shared_ptr<NodeQueue>     NodeQueuePtr;
+typedef std::vector<NodeQueuePtr>        NodeQueueVec;
+
+// 每个优先级的无锁任务队列容量，队列写满后溢出到加锁的链表中
+const size_t TASK_QUEUE_CAPACITY = 4096;
+
+// 线程每获取该数量的任务，就按从低到高的顺序检查一次各优先级队列，避免低优先级任务饿死
+const unsigned int STARVATION_INTERVAL = 16;
+
+// 单调时钟的当前时间（纳秒），用于计算排队时间和截止时间
+static inline long long SteadyNow()
+{
+	return boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+		boost::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 解析 "0-3,8-11" 格式的 CPU 或 NUMA 节点编号列表
+static std::vector<int> ParseIdList(const std::string& text)
+{
+	std::vector<int> ids;
+	std::istringstream stream(text);
+	std::string range;
+	while (std::getline(stream, range, ','))
+	{
+		int first = 0;
+		int last  = 0;
+		int count = sscanf(range.c_str(), "%d-%d", &first, &last);
+		if (count == 1)
+		{
+			last = first;
+		}
+		for (int i = first; count > 0 && i <= last; i++)
+		{
+			ids.push_back(i);
+		}
+	}
+	return ids;
+}
+
+// CPU 核心与 NUMA 节点的对应关系，进程内只读取一次
+class CpuTopology
+{
+public:
+	static const CpuTopology& Get()
+	{
+		static CpuTopology topology;
+		return topology;
+	}
+
+	int GetCpuCount() const
+	{
+		return int(m_cpuNodes.size());
+	}
+
+	int GetNode(int cpu) const
+	{
+		return cpu >= 0 && cpu < int(m_cpuNodes.size()) ? m_cpuNodes[cpu] : 0;
+	}
+
+private:
+	CpuTopology()
+	{
+		int count = int(boost::thread::hardware_concurrency());
+		m_cpuNodes.resize(count > 0 ? count : 1, 0);
+
+#if defined(WIN32) || defined(_WINDOWS)
+		for (int cpu = 0; cpu < int(m_cpuNodes.size()) && cpu < 256; cpu++)
+		{
+			UCHAR node = 0;
+			if (GetNumaProcessorNode(UCHAR(cpu), &node) && node != 0xFF)
+			{
+				m_cpuNodes[cpu] = node;
+			}
+		}
+#else
+		std::string line;
+		std::ifstream online("/sys/devices/system/node/online");
+		if (!std::getline(online, line))
+		{
+			return;
+		}
+
+		std::vector<int> nodes = ParseIdList(line);
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			std::ostringstream path;
+			path << "/sys/devices/system/node/node" << nodes[i] << "/cpulist";
+			std::ifstream cpulist(path.str().c_str());
+			if (!std::getline(cpulist, line))
+			{
+				continue;
+			}
+
+			std::vector<int> cpus = ParseIdList(line);
+			for (size_t j = 0; j < cpus.size(); j++)
+			{
+				if (cpus[j] >= int(m_cpuNodes.size()))
+				{
+					m_cpuNodes.resize(cpus[j] + 1, 0);
+				}
+				m_cpuNodes[cpus[j]] = nodes[i];
+			}
+		}
+#endif
+	}
+
+	std::vector<int> m_cpuNodes;
+};
+
+// 当前线程正在运行的 CPU 核心，无法获取时返回 -1
+static int GetCurrentCpu()
+{
+#if defined(WIN32) || defined(_WINDOWS)
+	return int(GetCurrentProcessorNumber());
+#else
+	return sched_getcpu();
+#endif
+}
+
+// 将当前线程绑定到指定的 CPU 核心上
+static bool BindCurrentThread(int cpu)
+{
+#if defined(WIN32) || defined(_WINDOWS)
+	return cpu >= 0 && cpu < int(sizeof(DWORD_PTR) * 8)
+		&& SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+	{
+		return false;
+	}
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#endif
+}
+
+// 自旋等待时提示 CPU 当前处于忙等待，降低功耗并让出超线程资源
+static inline void CpuRelax()
+{
+#if defined(_MSC_VER)
+	YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("pause");
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+// 队列中的任务条目
+struct TaskEntry
+{
+	TaskEntry() : enqueue_time(0), deadline(0), priority(TASK_PRIORITY_NORMAL) { }
+
+	ThreadTaskPtr task;
+
+	// 任务的取消令牌，缺省令牌永远不会被取消
+	CancellationToken token;
+
+	// 入队时间和截止时间（SteadyNow() 的纳秒值），截止时间为 0 表示没有截止时间
+	long long enqueue_time;
+	long long deadline;
+
+	int priority;
+};
+
+inline void swap(TaskEntry& lhs, TaskEntry& rhs)
+{
+	lhs.task.swap(rhs.task);
+	lhs.token.swap(rhs.token);
+	std::swap(lhs.enqueue_time, rhs.enqueue_time);
+	std::swap(lhs.deadline, rhs.deadline);
+	std::swap(lhs.priority, rhs.priority);
+}
+
+// 截止时间堆的比较函数，使截止时间最早的任务位于堆顶
+struct LaterDeadline
+{
+	bool operator()(const TaskEntry& lhs, const TaskEntry& rhs) const
+	{
+		return lhs.deadline > rhs.deadline;
+	}
+};
+
+// 一个优先级的任务队列：没有截止时间的任务进入无锁队列，按提交顺序执行；
+// 有截止时间的任务进入按截止时间排序的堆，并先于无锁队列中的任务执行
+class PriorityQueue
+{
+public:
+	PriorityQueue() : m_fifo(TASK_QUEUE_CAPACITY), m_overflowCount(0), m_deadlineCount(0)
+	{
+	}
+
+	// 加入任务。加锁的容器通过交换接管任务，不增加引用计数
+	void Push(TaskEntry& entry)
+	{
+		if (entry.deadline != 0)
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			m_deadlines.push_back(TaskEntry());
+			swap(m_deadlines.back(), entry);
+			std::push_heap(m_deadlines.begin(), m_deadlines.end(), LaterDeadline());
+			m_deadlineCount.fetch_add(1, boost::memory_order_release);
+			return;
+		}
+
+		// 溢出链表非空时继续写入链表，尽量保持任务的先后顺序
+		if (m_overflowCount.load(boost::memory_order_relaxed) != 0 || !m_fifo.TryPush(entry))
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			m_overflow.push_back(TaskEntry());
+			swap(m_overflow.back(), entry);
+			m_overflowCount.fetch_add(1, boost::memory_order_release);
+		}
+	}
+
+	// 批量加入没有截止时间的任务，无锁队列空间不足时整批写入溢出链表
+	void PushBulk(const std::vector<TaskEntry>& entries)
+	{
+		if (entries.empty())
+		{
+			return;
+		}
+
+		if (m_overflowCount.load(boost::memory_order_relaxed) != 0 || !m_fifo.TryPushBulk(&entries[0], entries.size()))
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			m_overflow.insert(m_overflow.end(), entries.begin(), entries.end());
+			m_overflowCount.fetch_add(entries.size(), boost::memory_order_release);
+		}
+	}
+
+	// 队列中的任务数，存在并发修改时为近似值
+	size_t Size() const
+	{
+		return m_fifo.SizeApprox() + m_overflowCount.load(boost::memory_order_relaxed)
+			+ m_deadlineCount.load(boost::memory_order_relaxed);
+	}
+
+	bool TryPop(TaskEntry& entry)
+	{
+		if (m_deadlineCount.load(boost::memory_order_acquire) != 0)
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			if (!m_deadlines.empty())
+			{
+				std::pop_heap(m_deadlines.begin(), m_deadlines.end(), LaterDeadline());
+				swap(entry, m_deadlines.back());
+				m_deadlines.pop_back();
+				m_deadlineCount.fetch_sub(1, boost::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		if (m_fifo.TryPop(entry))
+		{
+			return true;
+		}
+
+		if (m_overflowCount.load(boost::memory_order_acquire) != 0)
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			if (!m_overflow.empty())
+			{
+				swap(entry, m_overflow.front());
+				m_overflow.pop_front();
+				m_overflowCount.fetch_sub(1, boost::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// 取出最早提交的无截止时间任务，用于溢出时丢弃。截止时间堆中的任务不会被丢弃
+	bool DropOldest(TaskEntry& entry)
+	{
+		if (m_fifo.TryPop(entry))
+		{
+			return true;
+		}
+
+		if (m_overflowCount.load(boost::memory_order_acquire) != 0)
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			if (!m_overflow.empty())
+			{
+				swap(entry, m_overflow.front());
+				m_overflow.pop_front();
+				m_overflowCount.fetch_sub(1, boost::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	LockFreeQueue<TaskEntry> m_fifo;
+
+	TaskList m_overflow;
+
+	boost::atomic<size_t> m_overflowCount;
+
+	std::vector<TaskEntry> m_deadlines;
+
+	boost::atomic<size_t> m_deadlineCount;
+
+	boost::mutex m_mutex;
+};
+
+// 某一优先级的排队等待统计计数
+struct WaitCounter
+{
+	WaitCounter() : task_count(0), total_wait_ns(0), max_wait_ns(0), deadline_missed(0) { }
+
+	void Record(const TaskEntry& entry, long long now)
+	{
+		long long wait = now - entry.enqueue_time;
+		task_count.fetch_add(1, boost::memory_order_relaxed);
+		total_wait_ns.fetch_add(wait, boost::memory_order_relaxed);
+		long long max_wait = max_wait_ns.load(boost::memory_order_relaxed);
+		while (wait > max_wait && !max_wait_ns.compare_exchange_weak(max_wait, wait, boost::memory_order_relaxed))
+		{
+		}
+		if (entry.deadline != 0 && now > entry.deadline)
+		{
+			deadline_missed.fetch_add(1, boost::memory_order_relaxed);
+		}
+	}
+
+	// 不统计排队时间时只记录任务数，有截止时间的任务才读取时钟
+	void RecordCount(const TaskEntry& entry)
+	{
+		task_count.fetch_add(1, boost::memory_order_relaxed);
+		if (entry.deadline != 0 && SteadyNow() > entry.deadline)
+		{
+			deadline_missed.fetch_add(1, boost::memory_order_relaxed);
+		}
+	}
+
+	void Merge(const WaitCounter& other)
+	{
+		task_count.fetch_add(other.task_count.load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+		total_wait_ns.fetch_add(other.total_wait_ns.load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+		max_wait_ns.store(std::max(max_wait_ns.load(boost::memory_order_relaxed),
+			other.max_wait_ns.load(boost::memory_order_relaxed)), boost::memory_order_relaxed);
+		deadline_missed.fetch_add(other.deadline_missed.load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+	}
+
+	boost::atomic<long long> task_count;
+	boost::atomic<long long> total_wait_ns;
+	boost::atomic<long long> max_wait_ns;
+	boost::atomic<long long> deadline_missed;
+};
+
+// 耗时分布直方图的计数，桶的划分与 LatencyHistogram 相同
+struct HistogramCounter
+{
+	HistogramCounter() : total_ns(0)
+	{
+		for (int i = 0; i < POOL_HISTOGRAM_BUCKETS; i++)
+		{
+			buckets[i].store(0, boost::memory_order_relaxed);
+		}
+	}
+
+	void Record(long long ns)
+	{
+		long long us = ns / 1000;
+		int index = 0;
+		while (us > 0 && index < POOL_HISTOGRAM_BUCKETS - 1)
+		{
+			us >>= 1;
+			index++;
+		}
+		buckets[index].fetch_add(1, boost::memory_order_relaxed);
+		total_ns.fetch_add(ns, boost::memory_order_relaxed);
+	}
+
+	void AddTo(LatencyHistogram& histogram) const
+	{
+		for (int i = 0; i < POOL_HISTOGRAM_BUCKETS; i++)
+		{
+			long long count = buckets[i].load(boost::memory_order_relaxed);
+			histogram.buckets[i] += count;
+			histogram.count += count;
+		}
+		histogram.total_us += total_ns.load(boost::memory_order_relaxed) / 1000;
+	}
+
+	void Merge(const HistogramCounter& other)
+	{
+		for (int i = 0; i < POOL_HISTOGRAM_BUCKETS; i++)
+		{
+			buckets[i].fetch_add(other.buckets[i].load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+		}
+		total_ns.fetch_add(other.total_ns.load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+	}
+
+	boost::atomic<long long> buckets[POOL_HISTOGRAM_BUCKETS];
+	boost::atomic<long long> total_ns;
+};
+
+// 一个线程的运行统计计数。每个工作线程拥有独立的计数，只由该线程写入，读取统计时再汇总，
+// 避免所有线程竞争同一组原子变量
+struct WorkerCounters
+{
+	WorkerCounters() : exec_count(0), busy_ns(0), idle_ns(0), steal_count(0) { }
+
+	// 与相邻的堆对象隔开，避免伪共享
+	char pad[64];
+
+	WaitCounter waits[TASK_PRIORITY_COUNT];
+
+	HistogramCounter wait_histogram;
+	HistogramCounter exec_histogram;
+
+	boost::atomic<long long> exec_count;
+	boost::atomic<long long> busy_ns;
+	boost::atomic<long long> idle_ns;
+	boost::atomic<long long> steal_count;
+
+	// 合并已结束线程的计数，只在持有线程池互斥锁时调用
+	void Merge(const WorkerCounters& other)
+	{
+		for (int i = 0; i < TASK_PRIORITY_COUNT; i++)
+		{
+			waits[i].Merge(other.waits[i]);
+		}
+		wait_histogram.Merge(other.wait_histogram);
+		exec_histogram.Merge(other.exec_histogram);
+		exec_count.fetch_add(other.exec_count.load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+		busy_ns.fetch_add(other.busy_ns.load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+		idle_ns.fetch_add(other.idle_ns.load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+		steal_count.fetch_add(other.steal_count.load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+	}
+};
+
+// 工作窃取模式下每个线程的本地任务队列。队列所有者在队尾压入和弹出（后进先出），
+// 其它线程从队首窃取（先进先出），互斥锁仅在同一队列上发生窃取时才会产生竞争
+struct WorkerQueue
+{
+	WorkerQueue() : size(0), node(0) { }
+
+	boost::mutex mutex;
+	std::deque<TaskEntry> tasks;
+	boost::atomic<size_t> size;
+
+	// 所属线程的节点队列下标，窃取时优先选择同一节点的队列
+	size_t node;
+};
+
+// 一个 NUMA 节点的全局任务队列。线程池没有绑定 CPU 时只有一个节点队列
+struct NodeQueue
+{
+	NodeQueue() : node(0) { }
+
+	// 系统的 NUMA 节点编号
+	int node;
+
+	PriorityQueue queues[TASK_PRIORITY_COUNT];
+};
+
+// 一次任务执行的跟踪记录，时间为 SteadyNow() 的纳秒值
+struct TraceEvent
+{
+	const std::type_info* type;
+	long long begin;
+	long long end;
+};
+
+// 工作线程的任务跟踪缓冲区。只有所属线程写入，写满后循环覆盖最早的记录。
+// 按顺序锁（seqlock）的方式读取：记录的字段都是原子变量，写入计数以 release 语义发布，
+// 导出线程复制记录后重新读取计数，丢弃复制期间可能被覆盖的记录，无需加锁
+class TraceBuffer
+{
+public:
+	TraceBuffer(size_t capacity, int worker_id) : m_events(new TraceSlot[capacity]), m_capacity(capacity), m_count(0), m_workerId(worker_id)
+	{
+	}
+
+	~TraceBuffer()
+	{
+		delete[] m_events;
+	}
+
+	void Record(const std::type_info& type, long long begin, long long end)
+	{
+		size_t count = m_count.load(boost::memory_order_relaxed);
+		TraceSlot& slot = m_events[count % m_capacity];
+		slot.type.store(&type, boost::memory_order_relaxed);
+		slot.begin.store(begin, boost::memory_order_relaxed);
+		slot.end.store(end, boost::memory_order_relaxed);
+		m_count.store(count + 1, boost::memory_order_release);
+	}
+
+	// 复制缓冲区中的记录，复制期间被所属线程覆盖的记录不输出
+	void Snapshot(std::vector<TraceEvent>& events) const
+	{
+		size_t end = m_count.load(boost::memory_order_acquire);
+		size_t begin = end > m_capacity ? end - m_capacity : 0;
+		std::vector<TraceEvent> copied;
+		for (size_t i = begin; i < end; i++)
+		{
+			const TraceSlot& slot = m_events[i % m_capacity];
+			TraceEvent event;
+			event.type  = slot.type.load(boost::memory_order_relaxed);
+			event.begin = slot.begin.load(boost::memory_order_relaxed);
+			event.end   = slot.end.load(boost::memory_order_relaxed);
+			copied.push_back(event);
+		}
+
+		// 计数为 now 时所属线程可能正在写入第 now 条记录，即覆盖第 now - capacity 条记录，
+		// 因此只有第 now + 1 - capacity 条及之后的记录是完整的
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		size_t now = m_count.load(boost::memory_order_relaxed);
+		size_t valid = now + 1 > m_capacity ? now + 1 - m_capacity : 0;
+		for (size_t i = std::max(begin, valid); i < end; i++)
+		{
+			events.push_back(copied[i - begin]);
+		}
+	}
+
+	int GetWorkerId() const
+	{
+		return m_workerId;
+	}
+
+private:
+	TraceBuffer(const TraceBuffer&);
+	TraceBuffer& operator=(const TraceBuffer&);
+
+	struct TraceSlot
+	{
+		TraceSlot() : type(NULL), begin(0), end(0) { }
+
+		boost::atomic<const std::type_info*> type;
+		boost::atomic<long long> begin;
+		boost::atomic<long long> end;
+	};
+
+	TraceSlot* m_events;
+
+	size_t m_capacity;
+
+	boost::atomic<size_t> m_count;
+
+	int m_workerId;
+};
+
+typedef boost::shared_ptr<TraceBuffer> TraceBufferPtr;
+typedef std::vector<TraceBufferPtr>    TraceBufferVec;
+
+// 执行任务并记录执行统计。timing 为 false 且不跟踪时不读取时钟，只记录执行次数
+static void ExecuteTask(ThreadTask& task, WorkerCounters& counters, bool timing, TraceBuffer* trace)
+{
+	if (!timing && !trace)
+	{
+		task.Execute();
+		counters.exec_count.fetch_add(1, boost::memory_order_relaxed);
+		return;
+	}
+
+	// 任务执行后可能被释放，需要在执行前取得类型信息
+	const std::type_info* type = trace ? &typeid(task) : NULL;
+	long long start = SteadyNow();
+	task.Execute();
+	long long end = SteadyNow();
+	long long elapsed = end - start;
+	counters.exec_count.fetch_add(1, boost::memory_order_relaxed);
+	counters.exec_histogram.Record(elapsed);
+	counters.busy_ns.fetch_add(elapsed, boost::memory_order_relaxed);
+	if (trace)
+	{
+		trace->Record(*type, start, end);
+	}
+}
+
+// 转义 JSON 字符串中的特殊字符
+static std::string JsonEscape(const std::string& text)
+{
+	std::string result;
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		char c = text[i];
+		if (c == '"' || c == '\\')
+		{
+			result += '\\';
+			result += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			result += ' ';
+		}
+		else
+		{
+			result += c;
+		}
+	}
+	return result;
+}
+
+// 当前线程所属的工作线程，非线程池线程为 NULL
+static FM_THREAD_LOCAL WorkThread* t_currentWorker = NULL;
+
+// 选择窃取对象时使用的线程私有随机数种子
+static FM_THREAD_LOCAL unsigned int t_stealSeed = 0;
+
+// 当前线程获取任务的次数，用于低优先级任务的防饿死检查
+static FM_THREAD_LOCAL unsigned int t_popCount = 0;
 
 class WorkThread : public boost::enable_shared_from_this<WorkThread>
 {
 public:
-	WorkThread()
+	WorkThread() : m_cpu(-1), m_node(0), m_timing(true), m_exited(false)
 	{
 
 	}
 
-	~WorkThread()
+	~WorkThread()
+	{
+
+	}
+
+	void Initialize()
+	{
+		m_thread = ThreadPtr(new boost::thread(boost::bind(&WorkThread::TaskThread, shared_from_this())));
+	}
+
+	void Join()
+	{
+		if (m_thread)
+		{
+			m_thread->join();
+		}	
+	}
+
+	void SetThreadPool(ThreadPoolPtr threadpool)
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		m_threadpool = threadpool;
+	}
+
+	ThreadPool* GetThreadPool() const
+	{
+		return m_threadpool.get();
+	}
+
+	void SetLocalQueue(WorkerQueuePtr queue)
+	{
+		m_localQueue = queue;
+	}
+
+	WorkerQueue* GetLocalQueue() const
+	{
+		return m_localQueue.get();
+	}
+
+	// 设置线程绑定的 CPU 核心（-1 表示不绑定）和所属的节点队列下标，需要在 Initialize 之前调用
+	void SetPlacement(int cpu, size_t node)
+	{
+		m_cpu  = cpu;
+		m_node = node;
+	}
+
+	size_t GetNode() const
+	{
+		return m_node;
+	}
+
+	WorkerCounters& GetCounters()
+	{
+		return m_counters;
+	}
+
+	// 设置任务跟踪缓冲区，需要在 Initialize 之前调用
+	void SetTrace(TraceBufferPtr trace)
+	{
+		m_trace = trace;
+	}
+
+	TraceBuffer* GetTrace() const
+	{
+		return m_trace.get();
+	}
+
+	// 设置是否统计任务的执行时间，需要在 Initialize 之前调用
+	void SetTiming(bool timing)
+	{
+		m_timing = timing;
+	}
+
+	TraceBufferPtr GetTracePtr() const
+	{
+		return m_trace;
+	}
+
+	const WorkerCounters& GetCounters() const
+	{
+		return m_counters;
+	}
+
+	bool IsExited() const
+	{
+		return m_exited.load(boost::memory_order_acquire);
+	}
+
+	static void TaskThread(WorkThreadPtr workThread)
+	{
+		t_currentWorker = workThread.get();
+		if (workThread->m_cpu >= 0 && !BindCurrentThread(workThread->m_cpu))
+		{
+			LOG_WARNING("thread id:"<<boost::this_thread::get_id()<<" failed to bind cpu "<<workThread->m_cpu);
+		}
+		LOG_INFO("thread id:"<<boost::this_thread::get_id()<<" is start");
+		while(true)
+		{
+			ThreadTaskPtr task = workThread->m_threadpool->PopTask();
+
+			if (!task)
+			{
+				break;
+			}
+
+			ExecuteTask(*task, workThread->m_counters, workThread->m_timing, workThread->GetTrace());
+		}
+		LOG_INFO("thread id:"<<boost::this_thread::get_id()<<" is finished" );
+		workThread->m_exited.store(true, boost::memory_order_release);
+		t_currentWorker = NULL;
+	}
+private:
+	ThreadPtr m_thread;
+
+	ThreadPoolPtr m_threadpool;
+
+	WorkerQueuePtr m_localQueue;
+
+	int m_cpu;
+
+	size_t m_node;
+
+	WorkerCounters m_counters;
+
+	TraceBufferPtr m_trace;
+
+	bool m_timing;
+
+	boost::atomic<bool> m_exited;
+
+	boost::mutex m_mutex;
+}; 
+
+
+// 根据当前执行环境计算计算型线程池的线程数量
+static int GetContextThreadNum()
+{
+	const ExecutionContext& ctx = ExecutionContext::GetCurrent();
+	if (!ctx.multi_threaded)
+	{
+		return 1;
+	}
+	if (ctx.rlimit_cpu.limited_size > 0)
+	{
+		return ctx.rlimit_cpu.limited_size;
+	}
+	int threadNum = int(boost::thread::hardware_concurrency());
+	return threadNum > 0 ? threadNum : 1;
+}
+
+class ThreadPoolImpl : public boost::enable_shared_from_this<ThreadPoolImpl> , public ThreadPool
+{
+public:
+	ThreadPoolImpl(const ThreadPoolOptions& options):
+	  m_threadNum(options.thread_num),
+	  m_scheduler(options.scheduler),
+	  m_spawnCount(0),
+	  m_traceCapacity(options.trace_buffer_size),
+	  m_nextWorkerId(0),
+	  m_traceBase(SteadyNow()),
+	  m_collectTiming(options.collect_timing || options.auto_scale),
+	  m_autoScale(options.auto_scale),
+	  m_minThreadNum(std::max(options.min_thread_num, 1)),
+	  m_maxThreadNum(options.max_thread_num > 0 ? options.max_thread_num : GetContextThreadNum()),
+	  m_targetWaitNs(options.target_wait_us * 1000),
+	  m_lingerMs(options.idle_linger_ms),
+	  m_spinCount(std::max(options.idle_spin_count, 0)),
+	  m_yieldCount(std::max(options.idle_yield_count, 0)),
+	  m_queueCapacity(options.queue_capacity),
+	  m_overflowPolicy(options.overflow_policy),
+	  m_queuedCount(0),
+	  m_spaceWaiters(0),
+	  m_rejectedCount(0),
+	  m_droppedCount(0),
+	  m_cancelledCount(0),
+	  m_lastGrowTime(0),
+	  m_idleCount(0),
+	  m_retireCount(0),
+	  m_bTerminate(false)
+	{
+		if (options.cpu_affinity)
+		{
+			InitializePlacement(options.cpu_ids);
+		}
+		if (m_nodeQueues.empty())
+		{
+			m_nodeQueues.push_back(NodeQueuePtr(new NodeQueue()));
+		}
+		if (m_autoScale)
+		{
+			m_maxThreadNum = std::max(m_maxThreadNum, m_minThreadNum);
+			m_threadNum = std::max(m_minThreadNum, std::min(m_threadNum, m_maxThreadNum));
+		}
+	}
+
+	~ThreadPoolImpl()
+	{
+
+	}
+
+	void Initialize()
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		for (int i = 0; i < m_threadNum; i++)
+		{
+			SpawnWorker();
+		}
+	}
+
+	void Terminate()
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+
+		// 取消线程池的令牌，线程丢弃队列中剩余的任务后退出
+		m_cancelSource.Cancel();
+		m_bTerminate.store(true);
+		{
+			boost::unique_lock<boost::mutex> space_lock(m_space_mutex);
+			m_space_condition.notify_all();
+		}
+		boost::unique_lock<boost::mutex> park_lock(m_park_mutex);
+		m_condition.notify_all();
+	}
+
+	void Join()
+	{
+		while (true)
+		{
+			WorkThreadPtr workThread;
+			{
+				boost::unique_lock<boost::mutex> lock(m_mutex);
+				if (m_theadStack.empty())
+				{
+					break;
+				}
+				workThread = m_theadStack.front();
+			}
+
+			workThread->Join();
+			{
+				boost::unique_lock<boost::mutex> lock(m_mutex);
+				WorkThreadVec::iterator it = std::find(m_theadStack.begin(), m_theadStack.end(), workThread);
+				if (it != m_theadStack.end())
+				{
+					RetireWorker(workThread);
+					m_theadStack.erase(it);
+				}
+			}
+		}
+	}
+
+	void AdjustThreadNum(int threadNum)
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+
+		if (m_bTerminate.load() || threadNum < 0 || m_threadNum == threadNum)
+		{
+			return;
+		}
+		else if (m_threadNum < threadNum)
+		{
+			ReapExitedWorkers();
+			for (int i = 0; i < threadNum - m_threadNum; i++)
+			{
+				SpawnWorker();
+			}
+		}
+		else 
+		{
+			// 通知多余的线程退出，空闲线程被唤醒后会优先领取退出名额
+			m_retireCount.fetch_add(m_threadNum - threadNum);
+			boost::unique_lock<boost::mutex> park_lock(m_park_mutex);
+			m_condition.notify_all();
+		}
+		m_threadNum = threadNum;
+	}
+
+	int GetThreadNum() const
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		return m_threadNum;
+	}
+
+	int PushTask(ThreadTaskPtr task)
+	{
+		TaskEntry entry;
+		entry.task.swap(task);
+		entry.enqueue_time = EnqueueTime();
+
+		// 工作窃取模式下，线程池内部线程产生的任务压入本线程的本地队列
+		WorkerQueue* local = LocalQueue();
+		if (local)
+		{
+			{
+				boost::unique_lock<boost::mutex> lock(local->mutex);
+				local->tasks.push_back(TaskEntry());
+				swap(local->tasks.back(), entry);
+				local->size.store(local->tasks.size(), boost::memory_order_relaxed);
+			}
+			WakeWorker();
+			return TASK_PUSH_OK;
+		}
+
+		return PushGlobalTask(entry, TASK_ANY_NUMA_NODE, false);
+	}
+
+	int PushTask(ThreadTaskPtr task, int priority, long long deadline_ms, int numa_node)
+	{
+		TaskEntry entry;
+		entry.task.swap(task);
+		entry.enqueue_time = EnqueueTime();
+		entry.priority = std::max(TASK_PRIORITY_HIGH, std::min(priority, TASK_PRIORITY_LOW));
+		if (deadline_ms != TASK_NO_DEADLINE)
+		{
+			long long now = m_collectTiming ? entry.enqueue_time : SteadyNow();
+			entry.deadline = now + std::max(deadline_ms, 0LL) * 1000000;
+		}
+
+		return PushGlobalTask(entry, numa_node, false);
+	}
+
+	int PushTask(ThreadTaskPtr task, const CancellationToken& token, int priority)
+	{
+		TaskEntry entry;
+		entry.task.swap(task);
+		entry.token = token;
+		entry.enqueue_time = EnqueueTime();
+		entry.priority = std::max(TASK_PRIORITY_HIGH, std::min(priority, TASK_PRIORITY_LOW));
+		return PushGlobalTask(entry, TASK_ANY_NUMA_NODE, false);
+	}
+
+	int TryPushTask(ThreadTaskPtr task, int priority)
+	{
+		TaskEntry entry;
+		entry.task.swap(task);
+		entry.enqueue_time = EnqueueTime();
+		entry.priority = std::max(TASK_PRIORITY_HIGH, std::min(priority, TASK_PRIORITY_LOW));
+		return PushGlobalTask(entry, TASK_ANY_NUMA_NODE, true);
+	}
+
+	size_t PushTasks(const std::vector<ThreadTaskPtr>& tasks)
+	{
+		if (tasks.empty())
+		{
+			return 0;
+		}
+
+		// 有界队列模式下外部线程提交的任务逐个按溢出策略处理
+		if (m_queueCapacity != 0 && !CurrentWorker())
+		{
+			size_t accepted = 0;
+			for (size_t i = 0; i < tasks.size(); i++)
+			{
+				TaskEntry entry;
+				entry.task = tasks[i];
+				entry.enqueue_time = EnqueueTime();
+				if (PushGlobalTask(entry, TASK_ANY_NUMA_NODE, false) != TASK_PUSH_FULL)
+				{
+					accepted++;
+				}
+			}
+			return accepted;
+		}
+
+		std::vector<TaskEntry> entries(tasks.size());
+		long long now = EnqueueTime();
+		for (size_t i = 0; i < tasks.size(); i++)
+		{
+			entries[i].task = tasks[i];
+			entries[i].enqueue_time = now;
+		}
+
+		WorkerQueue* local = LocalQueue();
+		if (local)
+		{
+			boost::unique_lock<boost::mutex> lock(local->mutex);
+			local->tasks.insert(local->tasks.end(), entries.begin(), entries.end());
+			local->size.store(local->tasks.size(), boost::memory_order_relaxed);
+		}
+		else
+		{
+			if (m_queueCapacity != 0)
+			{
+				m_queuedCount.fetch_add(entries.size());
+			}
+			m_nodeQueues[SelectNode(TASK_ANY_NUMA_NODE)]->queues[TASK_PRIORITY_NORMAL].PushBulk(entries);
+		}
+		WakeWorkers(tasks.size());
+		return tasks.size();
+	}
+
+	bool RunPendingTask()
+	{
+		TaskEntry entry;
+		if (!TryPopTask(entry, LocalQueue(), WorkerNode()))
+		{
+			return false;
+		}
+
+		WorkThread* worker = CurrentWorker();
+		ExecuteTask(*entry.task, Counters(), m_collectTiming, worker ? worker->GetTrace() : NULL);
+		return true;
+	}
+
+	virtual ThreadTaskPtr PopTask()
+	{
+		WorkerQueue* local = LocalQueue();
+		size_t node = WorkerNode();
+		TaskEntry entry;
+		bool lingered = false;
+		while (true)
+		{
+			if (TryRetire())
+			{
+				RetireLocalQueue(local);
+				return ThreadTaskPtr();
+			}
+
+			if (TryPopTask(entry, local, node))
+			{
+				return entry.task;
+			}
+
+			if (m_bTerminate.load())
+			{
+				return ThreadTaskPtr();
+			}
+
+			// 空闲时间超过 idle_linger_ms 且线程数量多于下限时退出
+			if (lingered && TryAutoRetire())
+			{
+				RetireLocalQueue(local);
+				return ThreadTaskPtr();
+			}
+			lingered = false;
+
+			// 挂起前先自旋并让出 CPU 等待新任务，短暂空闲时避免挂起和唤醒的开销
+			if (SpinForTask(entry, local, node))
+			{
+				return entry.task;
+			}
+
+			// 队列为空，登记为空闲线程后挂起等待。登记后需要再检查一次队列，
+			// 与 WakeWorker 中的内存屏障配合避免丢失唤醒。持有等待锁时取出的已取消任务
+			// 在释放锁之后再调用 Cancel()，取消回调可能提交新任务而再次获取等待锁
+			std::vector<ThreadTaskPtr> cancelled;
+			boost::unique_lock<boost::mutex> lock(m_park_mutex);
+			m_idleCount.fetch_add(1);
+			boost::atomic_thread_fence(boost::memory_order_seq_cst);
+			bool found = false;
+			long long park_start = SteadyNow();
+			boost::chrono::steady_clock::time_point linger_end =
+				boost::chrono::steady_clock::now() + boost::chrono::milliseconds(m_lingerMs);
+			while (!(found = TryPopTask(entry, local, node, &cancelled)) && cancelled.empty()
+				&& m_retireCount.load() == 0 && !m_bTerminate.load())
+			{
+				if (!m_autoScale || !CurrentWorker())
+				{
+					m_condition.wait(lock);
+				}
+				else if (m_condition.wait_until(lock, linger_end) == boost::cv_status::timeout)
+				{
+					// 超时后回到外层循环，在释放等待锁的情况下再检查一次队列并尝试退出
+					lingered = true;
+					break;
+				}
+			}
+			m_idleCount.fetch_sub(1);
+			Counters().idle_ns.fetch_add(SteadyNow() - park_start, boost::memory_order_relaxed);
+			lock.unlock();
+
+			for (size_t i = 0; i < cancelled.size(); i++)
+			{
+				cancelled[i]->Cancel();
+			}
+			if (found)
+			{
+				return entry.task;
+			}
+		}
+	}
+
+	QueueWaitStats GetQueueWaitStats(int priority) const
+	{
+		QueueWaitStats stats;
+		if (priority < TASK_PRIORITY_HIGH || priority > TASK_PRIORITY_LOW)
+		{
+			return stats;
+		}
+
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		std::vector<const WorkerCounters*> all = AllCounters();
+		long long total_wait_ns = 0;
+		long long max_wait_ns = 0;
+		for (size_t i = 0; i < all.size(); i++)
+		{
+			const WaitCounter& counter = all[i]->waits[priority];
+			stats.task_count      += counter.task_count.load(boost::memory_order_relaxed);
+			stats.deadline_missed += counter.deadline_missed.load(boost::memory_order_relaxed);
+			total_wait_ns += counter.total_wait_ns.load(boost::memory_order_relaxed);
+			max_wait_ns = std::max(max_wait_ns, counter.max_wait_ns.load(boost::memory_order_relaxed));
+		}
+		stats.total_wait_us = total_wait_ns / 1000;
+		stats.max_wait_us   = max_wait_ns / 1000;
+		return stats;
+	}
+
+	ThreadPoolStats GetStats() const
+	{
+		ThreadPoolStats stats;
+		stats.idle_threads = m_idleCount.load(boost::memory_order_relaxed);
+		for (size_t i = 0; i < m_nodeQueues.size(); i++)
+		{
+			for (int j = 0; j < TASK_PRIORITY_COUNT; j++)
+			{
+				stats.queue_depth[j] += m_nodeQueues[i]->queues[j].Size();
+			}
+		}
+
+		long long busy_ns = 0;
+		long long idle_ns = 0;
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		stats.thread_num = m_threadNum;
+		std::vector<const WorkerCounters*> all = AllCounters();
+		for (size_t i = 0; i < all.size(); i++)
+		{
+			all[i]->wait_histogram.AddTo(stats.wait_histogram);
+			all[i]->exec_histogram.AddTo(stats.exec_histogram);
+			busy_ns += all[i]->busy_ns.load(boost::memory_order_relaxed);
+			idle_ns += all[i]->idle_ns.load(boost::memory_order_relaxed);
+		}
+
+		// 已退出的线程只计入汇总数据
+		for (size_t i = 0; i < m_theadStack.size(); i++)
+		{
+			if (m_theadStack[i]->IsExited())
+			{
+				continue;
+			}
+
+			const WorkerCounters& counters = m_theadStack[i]->GetCounters();
+			WorkerStats worker;
+			worker.tasks_executed = counters.exec_count.load(boost::memory_order_relaxed);
+			worker.steal_count    = counters.steal_count.load(boost::memory_order_relaxed);
+			worker.busy_us        = counters.busy_ns.load(boost::memory_order_relaxed) / 1000;
+			worker.idle_us        = counters.idle_ns.load(boost::memory_order_relaxed) / 1000;
+			WorkerQueue* local = m_theadStack[i]->GetLocalQueue();
+			if (local)
+			{
+				worker.local_queue_depth = local->size.load(boost::memory_order_relaxed);
+				stats.local_queue_depth += worker.local_queue_depth;
+			}
+			stats.workers.push_back(worker);
+		}
+		stats.busy_us = busy_ns / 1000;
+		stats.idle_us = idle_ns / 1000;
+		stats.rejected_tasks = m_rejectedCount.load(boost::memory_order_relaxed);
+		stats.dropped_tasks  = m_droppedCount.load(boost::memory_order_relaxed);
+		stats.cancelled_tasks = m_cancelledCount.load(boost::memory_order_relaxed);
+		return stats;
+	}
+
+	CancellationToken GetCancellationToken() const
+	{
+		return m_cancelSource.GetToken();
+	}
+
+	void DumpTrace(std::ostream& os) const
+	{
+		TraceBufferVec traces;
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			traces = m_retiredTraces;
+			for (size_t i = 0; i < m_theadStack.size(); i++)
+			{
+				if (m_theadStack[i]->GetTrace())
+				{
+					traces.push_back(m_theadStack[i]->GetTracePtr());
+				}
+			}
+		}
+
+		// 时间戳以微秒为单位，相对于线程池的创建时间
+		std::map<const std::type_info*, std::string> names;
+		std::ios::fmtflags flags = os.flags();
+		std::streamsize precision = os.precision();
+		os << std::fixed << std::setprecision(3);
+		os << "{\"traceEvents\":[";
+		bool first = true;
+		for (size_t i = 0; i < traces.size(); i++)
+		{
+			int tid = traces[i]->GetWorkerId();
+			os << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+				<< ",\"args\":{\"name\":\"worker " << tid << "\"}}";
+			first = false;
+
+			std::vector<TraceEvent> events;
+			traces[i]->Snapshot(events);
+			for (size_t j = 0; j < events.size(); j++)
+			{
+				std::string& name = names[events[j].type];
+				if (name.empty())
+				{
+					name = JsonEscape(boost::core::demangle(events[j].type->name()));
+				}
+				os << ",\n{\"name\":\"" << name << "\",\"cat\":\"task\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+					<< ",\"ts\":" << (events[j].begin - m_traceBase) / 1000.0
+					<< ",\"dur\":" << (events[j].end - events[j].begin) / 1000.0 << "}";
+			}
+		}
+		os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+		os.flags(flags);
+		os.precision(precision);
+	}
+	
+private:
+	// 确定绑定的 CPU 核心列表，并为其中每个 NUMA 节点建立节点队列
+	void InitializePlacement(const std::vector<int>& cpu_ids)
+	{
+		const CpuTopology& topology = CpuTopology::Get();
+		const ExecutionContext& ctx = ExecutionContext::GetCurrent();
+		m_cpuIds = cpu_ids;
+		if (m_cpuIds.empty() && ctx.rlimit_cpu.limited_size > 0 && ctx.rlimit_cpu.resource_id)
+		{
+			m_cpuIds.assign(ctx.rlimit_cpu.resource_id, ctx.rlimit_cpu.resource_id + ctx.rlimit_cpu.limited_size);
+		}
+		for (int cpu = 0; m_cpuIds.empty() && cpu < topology.GetCpuCount(); cpu++)
+		{
+			m_cpuIds.push_back(cpu);
+		}
+
+		for (size_t i = 0; i < m_cpuIds.size(); i++)
+		{
+			int node = topology.GetNode(m_cpuIds[i]);
+			if (FindNode(node) < 0)
+			{
+				NodeQueuePtr queue(new NodeQueue());
+				queue->node = node;
+				m_nodeQueues.push_back(queue);
+			}
+		}
+	}
+
+	int FindNode(int numa_node) const
+	{
+		for (size_t i = 0; i < m_nodeQueues.size(); i++)
+		{
+			if (m_nodeQueues[i]->node == numa_node)
+			{
+				return int(i);
+			}
+		}
+		return -1;
+	}
+
+	// 选择任务进入的节点队列：优先使用任务指定的节点，其次是提交线程所在的节点，
+	// 线程池在该节点上没有线程时按节点编号分散到各节点队列
+	size_t SelectNode(int numa_node) const
+	{
+		if (m_nodeQueues.size() == 1)
+		{
+			return 0;
+		}
+
+		if (numa_node == TASK_ANY_NUMA_NODE)
+		{
+			WorkThread* worker = CurrentWorker();
+			if (worker)
+			{
+				return worker->GetNode();
+			}
+			numa_node = GetCurrentNumaNode();
+		}
+
+		int index = FindNode(numa_node);
+		return index >= 0 ? size_t(index) : size_t(std::max(numa_node, 0)) % m_nodeQueues.size();
+	}
+
+	void SpawnWorker()
+	{
+		WorkThreadPtr workThread = WorkThreadPtr(new WorkThread());
+		workThread->SetThreadPool(shared_from_this());
+		if (!m_cpuIds.empty())
+		{
+			int cpu = m_cpuIds[m_spawnCount++ % m_cpuIds.size()];
+			workThread->SetPlacement(cpu, size_t(FindNode(CpuTopology::Get().GetNode(cpu))));
+		}
+		if (m_scheduler == POOL_SCHED_WORK_STEALING)
+		{
+			WorkerQueuePtr queue(new WorkerQueue());
+			queue->node = workThread->GetNode();
+			workThread->SetLocalQueue(queue);
+
+			// 以写时复制的方式发布本地队列列表，窃取线程读取的快照不会被修改
+			boost::shared_ptr<WorkerQueueVec> queues(new WorkerQueueVec());
+			boost::shared_ptr<WorkerQueueVec> current = boost::atomic_load(&m_workerQueues);
+			if (current)
+			{
+				*queues = *current;
+			}
+			queues->push_back(queue);
+			boost::atomic_store(&m_workerQueues, queues);
+		}
+		if (m_traceCapacity != 0)
+		{
+			workThread->SetTrace(TraceBufferPtr(new TraceBuffer(m_traceCapacity, m_nextWorkerId)));
+		}
+		workThread->SetTiming(m_collectTiming);
+		m_nextWorkerId++;
+		workThread->Initialize();
+
+		m_theadStack.push_back(workThread);
+	}
+
+	// 合并已退出线程的统计计数并保留其跟踪记录，调用者需持有 m_mutex
+	void RetireWorker(const WorkThreadPtr& workThread)
 	{
+		m_retiredCounters.Merge(workThread->GetCounters());
+		if (workThread->GetTrace())
+		{
+			m_retiredTraces.push_back(workThread->GetTracePtr());
+		}
+	}
+
+	// 退出的线程将本地队列中剩余的任务转入全局队列，并从窃取列表中移除
+	void RetireLocalQueue(WorkerQueue* local)
+	{
+		if (!local)
+		{
+			return;
+		}
 
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			boost::shared_ptr<WorkerQueueVec> queues(new WorkerQueueVec());
+			boost::shared_ptr<WorkerQueueVec> current = boost::atomic_load(&m_workerQueues);
+			for (size_t i = 0; current && i < current->size(); i++)
+			{
+				if ((*current)[i].get() != local)
+				{
+					queues->push_back((*current)[i]);
+				}
+			}
+			boost::atomic_store(&m_workerQueues, queues);
+		}
+
+		std::deque<TaskEntry> remains;
+		{
+			boost::unique_lock<boost::mutex> lock(local->mutex);
+			remains.swap(local->tasks);
+			local->size.store(0, boost::memory_order_relaxed);
+		}
+		if (m_queueCapacity != 0)
+		{
+			m_queuedCount.fetch_add(remains.size());
+		}
+		for (size_t i = 0; i < remains.size(); i++)
+		{
+			m_nodeQueues[local->node]->queues[remains[i].priority].Push(remains[i]);
+		}
+		if (!remains.empty())
+		{
+			WakeWorker();
+		}
 	}
 
-	void Initialize()
+	// 获取当前线程对应的本线程池工作线程，外部线程返回 NULL
+	WorkThread* CurrentWorker() const
 	{
-		m_thread = ThreadPtr(new boost::thread(boost::bind(WorkThread::TaskThread, shared_from_this())));
+		return t_currentWorker && t_currentWorker->GetThreadPool() == this ? t_currentWorker : NULL;
 	}
 
-	void Join()
+	// 获取当前线程在本线程池中的本地队列，非工作窃取模式或外部线程返回 NULL
+	WorkerQueue* LocalQueue() const
 	{
-		if (m_thread)
+		WorkThread* worker = CurrentWorker();
+		return worker ? worker->GetLocalQueue() : NULL;
+	}
+
+	// 汇总统计时需要读取的所有计数，调用者需持有 m_mutex
+	std::vector<const WorkerCounters*> AllCounters() const
+	{
+		std::vector<const WorkerCounters*> all;
+		for (size_t i = 0; i < m_theadStack.size(); i++)
 		{
-			m_thread->join();
-		}	
+			all.push_back(&m_theadStack[i]->GetCounters());
+		}
+		all.push_back(&m_externalCounters);
+		all.push_back(&m_retiredCounters);
+		return all;
 	}
 
-	void SetThreadPool(ThreadPoolPtr threadpool)
+	// 任务的入队时间，不统计排队时间时为 0，提交任务时无需读取时钟
+	long long EnqueueTime() const
 	{
-		boost::unique_lock<boost::mutex> lock(m_mutex);
-		m_threadpool = threadpool;
+		return m_collectTiming ? SteadyNow() : 0;
 	}
 
-	static void TaskThread(WorkThreadPtr workThread)
+	// 获取当前线程的统计计数，外部线程调用 PopTask 时共用一组计数
+	WorkerCounters& Counters()
 	{
-		LOG_INFO("thread id:"<<workThread->m_thread->get_id()<<" is start");
-		while(true)
-		{
-			ThreadTaskPtr task = workThread->m_threadpool->PopTask();
+		WorkThread* worker = CurrentWorker();
+		return worker ? worker->GetCounters() : m_externalCounters;
+	}
 
-			if (!task)
+	// 获取当前线程在本线程池中所属的节点队列下标，外部线程返回 0
+	size_t WorkerNode() const
+	{
+		WorkThread* worker = CurrentWorker();
+		return worker ? worker->GetNode() : 0;
+	}
+
+	// 获取下一个可执行的任务，已取消的任务在出队时丢弃。cancelled 不为空时已取消的任务放入其中，
+	// 由调用者在释放锁之后调用 ThreadTask::Cancel()，否则立即调用
+	bool TryPopTask(TaskEntry& entry, WorkerQueue* local, size_t node, std::vector<ThreadTaskPtr>* cancelled = NULL)
+	{
+		bool stolen = false;
+		bool found = false;
+		while (!found && TryTakeTask(entry, local, node, stolen))
+		{
+			found = !entry.token.IsCancellationRequested() && !m_cancelSource.IsCancellationRequested();
+			if (!found)
 			{
-				break;
+				m_cancelledCount.fetch_add(1, boost::memory_order_relaxed);
+				if (entry.task && cancelled)
+				{
+					cancelled->push_back(entry.task);
+				}
+				else if (entry.task)
+				{
+					entry.task->Cancel();
+				}
+				entry.task.reset();
+				entry.token = CancellationToken();
 			}
-			task->Execute();
 		}
-		LOG_INFO("thread id:"<<workThread->m_thread->get_id()<<" is finished" );
-	}
-private:
-	ThreadPtr m_thread;
 
-	ThreadPoolPtr m_threadpool;
-
-	boost::mutex m_mutex;
-}; 
+		if (found)
+		{
+			WorkerCounters& counters = Counters();
+			if (stolen)
+			{
+				counters.steal_count.fetch_add(1, boost::memory_order_relaxed);
+			}
+			if (!m_collectTiming)
+			{
+				counters.waits[entry.priority].RecordCount(entry);
+				return true;
+			}
 
+			long long now = SteadyNow();
+			counters.waits[entry.priority].Record(entry, now);
+			counters.wait_histogram.Record(now - entry.enqueue_time);
+			if (m_autoScale && now - entry.enqueue_time > m_targetWaitNs)
+			{
+				TryAutoGrow(now);
+			}
+		}
+		return found;
+	}
 
-class ThreadPoolImpl : public boost::enable_shared_from_this<ThreadPoolImpl> , public ThreadPool
-{
-public:
-	ThreadPoolImpl(int threadNum):
-	  m_threadNum(threadNum)
+	// 依次从本地队列、全局队列和其它线程的本地队列中取出一个任务
+	bool TryTakeTask(TaskEntry& entry, WorkerQueue* local, size_t node, bool& stolen)
 	{
-	
+		if (local && local->size.load(boost::memory_order_relaxed) != 0)
+		{
+			boost::unique_lock<boost::mutex> lock(local->mutex);
+			if (!local->tasks.empty())
+			{
+				swap(entry, local->tasks.back());
+				local->tasks.pop_back();
+				local->size.store(local->tasks.size(), boost::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		return TryPopGlobalTask(entry, node)
+			|| (m_scheduler == POOL_SCHED_WORK_STEALING && (stolen = TrySteal(entry, local, node)));
 	}
 
-	~ThreadPoolImpl()
+	// 按 idle_spin_count 和 idle_yield_count 忙等待新任务，需要退出或终止时立即返回
+	bool SpinForTask(TaskEntry& entry, WorkerQueue* local, size_t node)
 	{
+		for (int i = 0; i < m_spinCount + m_yieldCount; i++)
+		{
+			if (i < m_spinCount)
+			{
+				CpuRelax();
+			}
+			else
+			{
+				boost::this_thread::yield();
+			}
 
+			if (m_retireCount.load(boost::memory_order_relaxed) != 0 || m_bTerminate.load(boost::memory_order_relaxed))
+			{
+				return false;
+			}
+			if (TryPopTask(entry, local, node))
+			{
+				return true;
+			}
+		}
+		return false;
 	}
 
-	void Initialize()
+	// 任务排队时间超过目标且没有空闲线程时增加一个线程。两次增加之间至少间隔
+	// 目标排队时间，使新线程有机会消化积压的任务
+	void TryAutoGrow(long long now)
 	{
-		boost::unique_lock<boost::mutex> lock(m_mutex);
-		for (int i = 0; i < m_threadNum; i++)
+		if (m_idleCount.load(boost::memory_order_relaxed) != 0)
+		{
+			return;
+		}
+
+		long long last = m_lastGrowTime.load(boost::memory_order_relaxed);
+		if (now - last < m_targetWaitNs || !m_lastGrowTime.compare_exchange_strong(last, now))
 		{
-			WorkThreadPtr workThread = WorkThreadPtr(new WorkThread());
-			workThread->Initialize();
-			workThread->SetThreadPool(shared_from_this());
+			return;
+		}
 
-			m_theadStack.push_back(workThread);
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		if (m_bTerminate.load() || m_threadNum >= m_maxThreadNum)
+		{
+			return;
 		}
+		ReapExitedWorkers();
+		SpawnWorker();
+		m_threadNum++;
 	}
 
-	void Terminate()
+	// 空闲超时的线程在线程数量多于下限时领取退出名额
+	bool TryAutoRetire()
 	{
 		boost::unique_lock<boost::mutex> lock(m_mutex);
-		m_bTerminate = true;
-		for (int i = 0; i < m_threadNum; i++)
+		if (m_bTerminate.load() || m_threadNum <= m_minThreadNum)
 		{
-			PushTask(ThreadTaskPtr());
+			return false;
 		}
+		m_threadNum--;
+		ReapExitedWorkers();
+		return true;
 	}
 
-	void Join()
+	// 回收已退出的线程，释放线程栈并合并统计计数，调用者需持有 m_mutex
+	void ReapExitedWorkers()
 	{
 		WorkThreadVec::iterator it = m_theadStack.begin();
-		while(it != m_theadStack.end())
+		while (it != m_theadStack.end())
 		{
-			(*it)->Join();
+			if ((*it)->IsExited())
 			{
-				boost::unique_lock<boost::mutex> lock(m_mutex);
-				m_theadStack.erase(it);
-				it = m_theadStack.begin();
+				(*it)->Join();
+				RetireWorker(*it);
+				it = m_theadStack.erase(it);
+			}
+			else
+			{
+				++it;
 			}
 		}
 	}
 
-	void AdjustThreadNum(int threadNum)
+	bool TryPopGlobalTask(TaskEntry& entry, size_t node)
 	{
-		boost::unique_lock<boost::mutex> lock(m_mutex);
+		// 通常按优先级从高到低获取任务，每隔 STARVATION_INTERVAL 次反向检查一次。
+		// 先获取本节点的任务，本节点队列为空时再获取其它节点的任务
+		bool reverse = ++t_popCount % STARVATION_INTERVAL == 0;
+		size_t count = m_nodeQueues.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			PriorityQueue* queues = m_nodeQueues[(node + i) % count]->queues;
+			for (int j = 0; j < TASK_PRIORITY_COUNT; j++)
+			{
+				int priority = reverse ? TASK_PRIORITY_LOW - j : TASK_PRIORITY_HIGH + j;
+				if (queues[priority].TryPop(entry))
+				{
+					ReleaseSlot();
+					return true;
+				}
+			}
+		}
+		return false;
+	}
 
-		if (m_bTerminate || threadNum < 0 || m_threadNum == threadNum)
+	// 将任务加入全局队列，有界队列已满时按溢出策略处理
+	int PushGlobalTask(TaskEntry& entry, int numa_node, bool nonblocking)
+	{
+		int result = ReserveSlot(entry, nonblocking);
+		if (result != TASK_PUSH_OK)
 		{
-			return;
+			return result;
 		}
-		else if (m_threadNum < threadNum)
+
+		m_nodeQueues[SelectNode(numa_node)]->queues[entry.priority].Push(entry);
+		WakeWorker();
+		return TASK_PUSH_OK;
+	}
+
+	// 在全局队列中为一个任务预留位置。无界队列和线程池内部线程总是成功，
+	// 其它情况下队列已满时按溢出策略处理
+	int ReserveSlot(const TaskEntry& entry, bool nonblocking)
+	{
+		if (m_queueCapacity == 0)
 		{
-			for (int i = 0; i < threadNum - m_threadNum; i++)
+			return TASK_PUSH_OK;
+		}
+
+		if (CurrentWorker())
+		{
+			m_queuedCount.fetch_add(1);
+			return TASK_PUSH_OK;
+		}
+
+		while (true)
+		{
+			if (m_queuedCount.fetch_add(1) < m_queueCapacity)
 			{
-				WorkThreadPtr workThread = WorkThreadPtr(new WorkThread());
-				workThread->Initialize();
-				workThread->SetThreadPool(shared_from_this());
+				return TASK_PUSH_OK;
+			}
+			m_queuedCount.fetch_sub(1);
 
-				m_theadStack.push_back(workThread);
+			if (nonblocking || m_overflowPolicy == POOL_OVERFLOW_FAIL)
+			{
+				m_rejectedCount.fetch_add(1, boost::memory_order_relaxed);
+				return TASK_PUSH_FULL;
+			}
+			else if (m_overflowPolicy == POOL_OVERFLOW_CALLER_RUNS)
+			{
+				entry.task->Execute();
+				return TASK_PUSH_CALLER_RUNS;
+			}
+			else if (m_overflowPolicy == POOL_OVERFLOW_DROP_OLDEST && DropOldestTask())
+			{
+				continue;
+			}
+			else if (!WaitForSlot())
+			{
+				m_rejectedCount.fetch_add(1, boost::memory_order_relaxed);
+				return TASK_PUSH_FULL;
 			}
 		}
-		else 
+	}
+
+	// 全局队列中的任务出队后释放其预留的位置，并唤醒等待空间的提交线程
+	void ReleaseSlot()
+	{
+		if (m_queueCapacity == 0)
+		{
+			return;
+		}
+
+		m_queuedCount.fetch_sub(1);
+		boost::atomic_thread_fence(boost::memory_order_seq_cst);
+		if (m_spaceWaiters.load(boost::memory_order_relaxed) > 0)
 		{
-			for (int i = 0; i < m_threadNum - threadNum; i++)
+			boost::unique_lock<boost::mutex> lock(m_space_mutex);
+			m_space_condition.notify_one();
+		}
+	}
+
+	// 阻塞等待全局队列出现空间，线程池终止时返回 false
+	bool WaitForSlot()
+	{
+		boost::unique_lock<boost::mutex> lock(m_space_mutex);
+		m_spaceWaiters.fetch_add(1);
+		boost::atomic_thread_fence(boost::memory_order_seq_cst);
+		while (m_queuedCount.load() >= m_queueCapacity && !m_bTerminate.load())
+		{
+			m_space_condition.wait(lock);
+		}
+		m_spaceWaiters.fetch_sub(1);
+		return !m_bTerminate.load();
+	}
+
+	// 丢弃全局队列中最早提交的低优先级任务，没有可丢弃的任务时返回 false，由调用者阻塞等待空间。
+	// 被丢弃的任务通过 ThreadTask::Cancel() 通知等待者，避免其永远阻塞
+	bool DropOldestTask()
+	{
+		TaskEntry entry;
+		for (size_t j = 0; j < m_nodeQueues.size(); j++)
+		{
+			if (m_nodeQueues[j]->queues[TASK_PRIORITY_LOW].DropOldest(entry))
 			{
-				boost::unique_lock<boost::mutex> lock(m_task_mutex);
-				m_taskStack.push_front(ThreadTaskPtr());
-				m_condition.notify_one();
+				ReleaseSlot();
+				m_droppedCount.fetch_add(1, boost::memory_order_relaxed);
+				entry.task->Cancel();
+				return true;
 			}
 		}
-		m_threadNum = threadNum;
+		return false;
 	}
 
-	void PushTask(ThreadTaskPtr task)
+	bool TrySteal(TaskEntry& entry, WorkerQueue* local, size_t node)
 	{
-		boost::unique_lock<boost::mutex> lock(m_task_mutex);
-		m_taskStack.push_back(task);
+		boost::shared_ptr<WorkerQueueVec> queues = boost::atomic_load(&m_workerQueues);
+		if (!queues || queues->empty())
+		{
+			return false;
+		}
+
+		// 从随机位置开始轮询，避免所有空闲线程同时窃取同一个队列
+		t_stealSeed = t_stealSeed * 1103515245 + 12345;
+		size_t count = queues->size();
+		size_t start = (t_stealSeed >> 16) % count;
+
+		// 存在多个节点时，先窃取同一节点的线程，再窃取其它节点的线程
+		int passes = m_nodeQueues.size() > 1 ? 2 : 1;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				WorkerQueue* victim = (*queues)[(start + i) % count].get();
+				if (victim == local || victim->size.load(boost::memory_order_relaxed) == 0
+					|| (passes > 1 && (victim->node == node) != (pass == 0)))
+				{
+					continue;
+				}
 
-		m_condition.notify_one();
+				boost::unique_lock<boost::mutex> lock(victim->mutex);
+				if (!victim->tasks.empty())
+				{
+					swap(entry, victim->tasks.front());
+					victim->tasks.pop_front();
+					victim->size.store(victim->tasks.size(), boost::memory_order_relaxed);
+					return true;
+				}
+			}
+		}
+		return false;
 	}
 
-	virtual ThreadTaskPtr PopTask()
+	bool TryRetire()
 	{
-		boost::unique_lock<boost::mutex> lock(m_task_mutex);
-		if (m_taskStack.size() == 0)
+		int retire = m_retireCount.load(boost::memory_order_relaxed);
+		while (retire > 0)
 		{
-			m_condition.wait(lock);
-			std::cout<<"condition is notify"<<std::endl;
+			if (m_retireCount.compare_exchange_weak(retire, retire - 1))
+			{
+				return true;
+			}
 		}
+		return false;
+	}
 
-		ThreadTaskPtr task = m_taskStack.front();
-		m_taskStack.pop_front();
-		return task;
+	void WakeWorker()
+	{
+		WakeWorkers(1);
 	}
-	
-private:
+
+	// 最多唤醒 min(count, 空闲线程数) 个线程。只有存在空闲线程时才进入互斥区唤醒，
+	// 繁忙时入队不触发任何系统调用
+	void WakeWorkers(size_t count)
+	{
+		boost::atomic_thread_fence(boost::memory_order_seq_cst);
+		int idle = m_idleCount.load(boost::memory_order_relaxed);
+		if (idle > 0)
+		{
+			boost::unique_lock<boost::mutex> lock(m_park_mutex);
+			if (count >= size_t(idle))
+			{
+				m_condition.notify_all();
+			}
+			else
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					m_condition.notify_one();
+				}
+			}
+		}
+	}
+
 	int m_threadNum;
 
-	TaskList m_taskStack;
+	int m_scheduler;
+
+	// 绑定的 CPU 核心列表，为空表示不绑定；新线程按创建顺序依次绑定
+	std::vector<int> m_cpuIds;
+
+	size_t m_spawnCount;
+
+	// 按 NUMA 节点划分的全局任务队列，创建后不再变化
+	NodeQueueVec m_nodeQueues;
+
+	WorkerCounters m_externalCounters;
+
+	// 已被 Join 回收的线程的计数
+	WorkerCounters m_retiredCounters;
+
+	// 任务跟踪：每个线程的记录数、下一个线程的编号、已退出线程的跟踪缓冲区和计时起点
+	size_t m_traceCapacity;
+
+	int m_nextWorkerId;
+
+	TraceBufferVec m_retiredTraces;
+
+	long long m_traceBase;
+
+	// 是否统计任务的排队时间和执行时间，自动调整线程数量依赖排队时间，开启时总会统计
+	bool m_collectTiming;
+
+	boost::shared_ptr<WorkerQueueVec> m_workerQueues;
 
 	WorkThreadVec m_theadStack;
 
-	boost::mutex m_task_mutex;
+	mutable boost::mutex m_mutex;
 
-	boost::mutex m_mutex;
+	boost::mutex m_park_mutex;
 
 	boost::condition_variable m_condition;
 
-	bool m_bTerminate;
+	// 自动调整线程数量的参数
+	bool m_autoScale;
+	int m_minThreadNum;
+	int m_maxThreadNum;
+	long long m_targetWaitNs;
+	long long m_lingerMs;
+
+	// 空闲时挂起前的自旋和让出 CPU 次数
+	int m_spinCount;
+	int m_yieldCount;
+
+	// 有界队列的容量和溢出策略，容量为 0 表示不限制
+	size_t m_queueCapacity;
+	int m_overflowPolicy;
+
+	// 全局队列中已预留位置的任务数，只在有界队列模式下维护
+	boost::atomic<size_t> m_queuedCount;
+
+	boost::atomic<int> m_spaceWaiters;
+
+	boost::atomic<long long> m_rejectedCount;
+
+	boost::atomic<long long> m_droppedCount;
+
+	boost::atomic<long long> m_cancelledCount;
+
+	CancellationSource m_cancelSource;
+
+	boost::mutex m_space_mutex;
+
+	boost::condition_variable m_space_condition;
+
+	// 上一次自动增加线程的时间
+	boost::atomic<long long> m_lastGrowTime;
+
+	boost::atomic<int> m_idleCount;
+
+	boost::atomic<int> m_retireCount;
+
+	boost::atomic<bool> m_bTerminate;
 };
 
 
+LatencyHistogram::LatencyHistogram()
+	: count(0),
+	  total_us(0)
+{
+	std::fill(buckets, buckets + POOL_HISTOGRAM_BUCKETS, 0LL);
+}
+
+long long LatencyHistogram::GetPercentileUs(double percentile) const
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	long long target = (long long)(std::max(0.0, std::min(percentile, 1.0)) * count);
+	long long accumulated = 0;
+	for (int i = 0; i < POOL_HISTOGRAM_BUCKETS; i++)
+	{
+		accumulated += buckets[i];
+		if (accumulated >= target && accumulated > 0)
+		{
+			return 1LL << i;
+		}
+	}
+	return 1LL << (POOL_HISTOGRAM_BUCKETS - 1);
+}
+
+WorkerStats::WorkerStats()
+	: tasks_executed(0),
+	  steal_count(0),
+	  busy_us(0),
+	  idle_us(0),
+	  local_queue_depth(0)
+{
+}
+
+ThreadPoolStats::ThreadPoolStats()
+	: thread_num(0),
+	  idle_threads(0),
+	  local_queue_depth(0),
+	  busy_us(0),
+	  idle_us(0),
+	  rejected_tasks(0),
+	  dropped_tasks(0),
+	  cancelled_tasks(0)
+{
+	std::fill(queue_depth, queue_depth + TASK_PRIORITY_COUNT, size_t(0));
+}
+
+ThreadPoolOptions::ThreadPoolOptions()
+	: thread_num(1),
+	  scheduler(POOL_SCHED_SHARED_QUEUE),
+	  cpu_affinity(false),
+	  auto_scale(false),
+	  min_thread_num(1),
+	  max_thread_num(0),
+	  target_wait_us(1000),
+	  idle_linger_ms(30000),
+	  queue_capacity(0),
+	  overflow_policy(POOL_OVERFLOW_BLOCK),
+	  idle_spin_count(0),
+	  idle_yield_count(0),
+	  trace_buffer_size(0),
+	  collect_timing(true)
+{
+}
+
 LIB_SDK ThreadPoolPtr CreateThreadPool(int threadNum)
 {
-	boost::shared_ptr<ThreadPoolImpl> threadPoolimpl(new ThreadPoolImpl(threadNum));
+	ThreadPoolOptions options;
+	options.thread_num = threadNum;
+	return CreateThreadPool(options);
+}
+
+LIB_SDK ThreadPoolPtr CreateThreadPool(const ThreadPoolOptions& options)
+{
+	boost::shared_ptr<ThreadPoolImpl> threadPoolimpl(new ThreadPoolImpl(options));
 	threadPoolimpl->Initialize();
 	return threadPoolimpl;
 }
 
-}
\ No newline at end of file
+static ThreadPoolPtr default_thread_pool;
+static boost::once_flag default_thread_pool_once = BOOST_ONCE_INIT;
+
+static void CreateDefaultThreadPool()
+{
+	ThreadPoolOptions options;
+	options.thread_num = GetContextThreadNum();
+	options.scheduler  = POOL_SCHED_WORK_STEALING;
+
+	const ExecutionContext& ctx = ExecutionContext::GetCurrent();
+	options.cpu_affinity = ctx.multi_threaded && ctx.rlimit_cpu.limited_size > 0 && ctx.rlimit_cpu.resource_id;
+	default_thread_pool = CreateThreadPool(options);
+}
+
+LIB_SDK ThreadPoolPtr GetDefaultThreadPool()
+{
+	boost::call_once(&CreateDefaultThreadPool, default_thread_pool_once);
+	return default_thread_pool;
+}
+
+static ThreadPoolPtr io_thread_pool;
+static boost::once_flag io_thread_pool_once = BOOST_ONCE_INIT;
+
+static void CreateIOThreadPool()
+{
+	if (!ExecutionContext::GetCurrent().io_thread_allowed)
+	{
+		io_thread_pool = GetDefaultThreadPool();
+		return;
+	}
+
+	ThreadPoolOptions options;
+	options.thread_num = GetContextThreadNum() * IO_THREADS_PER_CPU;
+	options.scheduler  = POOL_SCHED_SHARED_QUEUE;
+	io_thread_pool = CreateThreadPool(options);
+}
+
+LIB_SDK ThreadPoolPtr GetIOThreadPool()
+{
+	boost::call_once(&CreateIOThreadPool, io_thread_pool_once);
+	return io_thread_pool;
+}
+
+LIB_SDK ThreadPoolPtr GetThreadPool(int kind)
+{
+	return kind == TASK_KIND_IO ? GetIOThreadPool() : GetDefaultThreadPool();
+}
+
+LIB_SDK int GetCurrentNumaNode()
+{
+	return CpuTopology::Get().GetNode(GetCurrentCpu());
+}
+
+}
@@ -1,11 +1,103 @@
 ﻿#ifndef _FM_SDK_THREADPOOL_H_
 #define _FM_SDK_THREADPOOL_H_
 
+#include <vector>
+#include <boost/utility/result_of.hpp>
+#include <boost/make_shared.hpp>
 #include "SystemExport.h"
 #include "ThreadTask.h"
+#include "Future.h"
+#include "Exception.h"
+#include "CancellationToken.h"
 
 namespace fm{
 
+const int TASK_PRIORITY_HIGH   = 0;  /**< 高优先级，用于延迟敏感的任务 */
+const int TASK_PRIORITY_NORMAL = 1;  /**< 普通优先级（默认）           */
+const int TASK_PRIORITY_LOW    = 2;  /**< 低优先级，用于批量后台任务   */
+const int TASK_PRIORITY_COUNT  = 3;  /**< 优先级的数量                 */
+
+const long long TASK_NO_DEADLINE = -1;  /**< 任务没有截止时间 */
+
+const int TASK_ANY_NUMA_NODE = -1;  /**< 任务没有指定 NUMA 节点 */
+
+const int TASK_PUSH_OK          = 0;  /**< 任务已进入队列                       */
+const int TASK_PUSH_FULL        = 1;  /**< 队列已满，任务被拒绝且没有执行       */
+const int TASK_PUSH_CALLER_RUNS = 2;  /**< 队列已满，任务已在提交线程中执行     */
+
+/**
+ * @brief 某一优先级任务的排队等待统计
+ */
+struct LIB_SDK QueueWaitStats
+{
+	QueueWaitStats() : task_count(0), total_wait_us(0), max_wait_us(0), deadline_missed(0) { }
+
+	long long task_count;       /**< 已出队的任务数             */
+	long long total_wait_us;    /**< 累计排队时间（微秒）       */
+	long long max_wait_us;      /**< 最长排队时间（微秒）       */
+	long long deadline_missed;  /**< 出队时已超过截止时间的任务数 */
+};
+
+const int POOL_HISTOGRAM_BUCKETS = 32;  /**< 耗时分布直方图的桶数 */
+
+/**
+ * @brief 耗时分布直方图
+ * @note 第 0 个桶统计小于 1 微秒的次数，第 i 个桶统计 [2^(i-1), 2^i) 微秒的次数，
+ *       最后一个桶同时包含所有更长的耗时。
+ */
+struct LIB_SDK LatencyHistogram
+{
+	LatencyHistogram();
+
+	/**
+	 * @brief 估算指定百分位的耗时
+	 *
+	 * @param[in] percentile 百分位（0 ~ 1，例如 0.99）
+	 *
+	 * @return 该百分位所在桶的上界（微秒），没有任何记录时返回 0
+	 */
+	long long GetPercentileUs(double percentile) const;
+
+	long long count;                            /**< 记录的次数         */
+	long long total_us;                         /**< 累计耗时（微秒）   */
+	long long buckets[POOL_HISTOGRAM_BUCKETS];  /**< 各个桶的记录次数   */
+};
+
+/**
+ * @brief 单个工作线程的运行统计
+ */
+struct LIB_SDK WorkerStats
+{
+	WorkerStats();
+
+	long long tasks_executed;    /**< 已执行的任务数               */
+	long long steal_count;       /**< 从其它线程窃取的任务数       */
+	long long busy_us;           /**< 执行任务的累计时间（微秒）   */
+	long long idle_us;           /**< 挂起等待的累计时间（微秒）   */
+	size_t    local_queue_depth; /**< 本地队列中的任务数（工作窃取）*/
+};
+
+/**
+ * @brief 线程池的运行统计快照
+ */
+struct LIB_SDK ThreadPoolStats
+{
+	ThreadPoolStats();
+
+	int    thread_num;                             /**< 线程数量                       */
+	int    idle_threads;                           /**< 当前挂起等待的线程数           */
+	size_t queue_depth[TASK_PRIORITY_COUNT];       /**< 各优先级全局队列中的任务数     */
+	size_t local_queue_depth;                      /**< 所有线程本地队列中的任务数     */
+	long long busy_us;                             /**< 所有线程执行任务的累计时间（微秒） */
+	long long idle_us;                             /**< 所有线程挂起等待的累计时间（微秒） */
+	long long rejected_tasks;                      /**< 队列已满时被拒绝的任务数       */
+	long long dropped_tasks;                       /**< 队列已满时被丢弃的最早任务数   */
+	long long cancelled_tasks;                     /**< 因取消而未执行就被丢弃的任务数 */
+	LatencyHistogram wait_histogram;               /**< 任务排队时间的分布             */
+	LatencyHistogram exec_histogram;               /**< 任务执行时间的分布             */
+	std::vector<WorkerStats> workers;              /**< 仍在运行的各个线程的统计       */
+};
+
 /**
  * @brief 线程池基类
  */
@@ -14,8 +106,10 @@ class LIB_SDK ThreadPool
 {
 public:
 	/**
-     * @brief 终止线程池内的所有线程，调用该方法后调用 Join()等待线程结束。请确保当前正在执行的任务能够收到
-	 *        结束通知
+     * @brief 终止线程池内的所有线程，调用该方法后调用 Join()等待线程结束。
+	 *
+	 * @note 终止时取消线程池的取消令牌：队列中尚未执行的任务被丢弃（调用 ThreadTask::Cancel()），
+	 *       正在执行的长任务应通过 GetCancellationToken() 检查取消请求并尽快返回。
      */
 	virtual void Terminate() = 0;
 
@@ -32,12 +126,84 @@ public:
      */
 	virtual void AdjustThreadNum(int threadNum) = 0;
 
+	/**
+     * @brief 获取线程池内线程的数量
+	 *   
+	 * @return 当前设定的线程数量
+     */
+	virtual int GetThreadNum() const = 0;
+
 	/**
      * @brief 增加线程任务
 	 *   
 	 * @param[in] task 线程任务
+	 *
+	 * @return TASK_PUSH_OK、TASK_PUSH_FULL 或 TASK_PUSH_CALLER_RUNS，见 ThreadPoolOptions::overflow_policy
+     */
+	virtual int PushTask(ThreadTaskPtr task) = 0;
+
+	/**
+     * @brief 按指定优先级和截止时间增加线程任务
+	 *   
+	 * @param[in] task 线程任务
+	 * @param[in] priority 任务优先级（TASK_PRIORITY_HIGH、TASK_PRIORITY_NORMAL 或 TASK_PRIORITY_LOW）
+	 * @param[in] deadline_ms 相对当前时间的截止时间（毫秒），TASK_NO_DEADLINE 表示没有截止时间
+	 * @param[in] numa_node 任务数据所在的 NUMA 节点，TASK_ANY_NUMA_NODE 表示使用提交线程所在的节点
+	 * @note 线程优先获取高优先级的任务，同一优先级中有截止时间的任务按截止时间先后执行，其余任务按提交顺序执行。
+	 *       为避免低优先级任务饿死，线程每获取若干个任务会优先检查一次低优先级的队列。
+	 *       线程池绑定了 CPU 时，任务进入 numa_node 节点的队列，由该节点上的线程优先执行。
+	 *
+	 * @return TASK_PUSH_OK、TASK_PUSH_FULL 或 TASK_PUSH_CALLER_RUNS，见 ThreadPoolOptions::overflow_policy
+     */
+	virtual int PushTask(ThreadTaskPtr task, int priority, long long deadline_ms = TASK_NO_DEADLINE,
+		int numa_node = TASK_ANY_NUMA_NODE) = 0;
+
+	/**
+     * @brief 增加可取消的线程任务
+	 *   
+	 * @param[in] task 线程任务
+	 * @param[in] token 取消令牌
+	 * @param[in] priority 任务优先级
+	 * @note 令牌被取消时任务如果仍在队列中，出队时直接丢弃并调用 ThreadTask::Cancel()，不再执行。
+	 *       正在执行的任务需要自行检查令牌。
+	 *
+	 * @return TASK_PUSH_OK、TASK_PUSH_FULL 或 TASK_PUSH_CALLER_RUNS，见 ThreadPoolOptions::overflow_policy
+     */
+	virtual int PushTask(ThreadTaskPtr task, const CancellationToken& token, int priority = TASK_PRIORITY_NORMAL) = 0;
+
+	/**
+     * @brief 批量增加线程任务
+	 *   
+	 * @param[in] tasks 线程任务列表
+	 * @note 整批任务只经过一次同步入队，并且最多唤醒 min(任务数, 空闲线程数) 个线程，
+	 *       适合一次性分发大量任务的场景。有界队列模式下逐个按溢出策略提交。
+	 *
+	 * @return 进入队列或已在提交线程中执行的任务数
+     */
+	virtual size_t PushTasks(const std::vector<ThreadTaskPtr>& tasks) = 0;
+
+	/**
+     * @brief 批量增加线程任务
+	 *   
+	 * @param[in] begin 线程任务序列的起始位置
+	 * @param[in] end 线程任务序列的结束位置
      */
-	virtual void PushTask(ThreadTaskPtr task) = 0;
+	template<typename Iterator>
+	size_t PushTasks(Iterator begin, Iterator end)
+	{
+		std::vector<ThreadTaskPtr> tasks(begin, end);
+		return PushTasks(tasks);
+	}
+
+	/**
+     * @brief 尝试增加线程任务，调用线程不会阻塞
+	 *   
+	 * @param[in] task 线程任务
+	 * @param[in] priority 任务优先级
+	 *
+	 * @return 任务进入队列时返回 TASK_PUSH_OK；有界队列已满时无论溢出策略如何都返回 TASK_PUSH_FULL
+     */
+	virtual int TryPushTask(ThreadTaskPtr task, int priority = TASK_PRIORITY_NORMAL) = 0;
 
 	/**
     * @brief 获取任务，如果任务队列为空则阻塞
@@ -45,10 +211,279 @@ public:
 	* @return 返回下一个任务对象
     */
 	virtual ThreadTaskPtr PopTask() = 0;
+
+	/**
+    * @brief 在当前线程中执行一个排队的任务，用于等待子任务时帮助执行其它任务
+	*
+	* @return 执行了一个任务时返回 true，没有可执行的任务时立即返回 false
+	* @note 线程池内部线程优先执行本线程本地队列中最近提交的任务。等待子任务完成的线程
+	*       循环调用该方法，可以避免所有线程都在等待时线程池死锁。
+    */
+	virtual bool RunPendingTask() = 0;
+
+	/**
+    * @brief 获取指定优先级任务的排队等待统计
+	*
+	* @param[in] priority 任务优先级
+	*
+	* @return 自线程池创建以来的统计数据
+    */
+	virtual QueueWaitStats GetQueueWaitStats(int priority) const = 0;
+
+	/**
+    * @brief 获取线程池的运行统计快照
+	*
+	* @return 自线程池创建以来的统计数据
+	* @note 统计计数由各线程独立记录，读取时汇总，不会阻塞正在执行任务的线程，
+	*       适合周期性采集。队列长度为近似值。
+    */
+	virtual ThreadPoolStats GetStats() const = 0;
+
+	/**
+    * @brief 获取线程池的取消令牌，调用 Terminate() 后令牌处于已取消状态
+	*
+	* @note 任务在执行过程中轮询该令牌，可以在线程池终止时尽快结束。
+    */
+	virtual CancellationToken GetCancellationToken() const = 0;
+
+	/**
+    * @brief 以 Chrome trace-event JSON 格式导出任务跟踪记录，可在 chrome://tracing 或 Perfetto 中打开
+	*
+	* @param[in] os 输出流
+	* @note 需要创建线程池时设置 ThreadPoolOptions::trace_buffer_size。每个线程对应一行，每次任务执行
+	*       对应一个区间，名称为任务的类型名。只记录线程池内部线程执行的任务。导出时不会阻塞执行任务的线程，
+	*       导出过程中被覆盖的记录会被跳过。
+    */
+	virtual void DumpTrace(std::ostream& os) const = 0;
+
+	/**
+     * @brief 提交可调用对象作为线程任务，并返回其异步结果
+	 *
+	 * @param[in] func 无参数的可调用对象（函数、函数对象或 lambda）
+	 *
+	 * @return 可用于等待任务完成并获取返回值的 Future 对象
+	 * @note 任务对象与结果共享状态在任务内存池的同一个块中创建，无需为每个任务单独实现 ThreadTask 子类。
+	 *       任务被有界队列拒绝时，Future::Get() 抛出 InvalidOperationException；
+	 *       任务未执行就被丢弃或取消时，Future::Get() 抛出 OperationCanceledException。
+     */
+	template<typename F>
+	Future<typename boost::result_of<F()>::type> Submit(F func)
+	{
+		typedef typename boost::result_of<F()>::type R;
+		boost::shared_ptr<FutureTask<R, F> > task = MakeTask<FutureTask<R, F> >(func);
+		if (PushTask(task) == TASK_PUSH_FULL)
+		{
+			task->SetException(boost::copy_exception(InvalidOperationException("ThreadPool task queue is full.")));
+		}
+		return Future<R>(task);
+	}
+
+	/**
+     * @brief 提交可取消的可调用对象作为线程任务，并返回其异步结果
+	 *
+	 * @param[in] func 无参数的可调用对象（函数、函数对象或 lambda）
+	 * @param[in] token 取消令牌，令牌被取消时尚未执行的任务被丢弃，Future::Get() 抛出 OperationCanceledException
+	 *
+	 * @return 可用于等待任务完成并获取返回值的 Future 对象
+     */
+	template<typename F>
+	Future<typename boost::result_of<F()>::type> Submit(F func, const CancellationToken& token)
+	{
+		typedef typename boost::result_of<F()>::type R;
+		boost::shared_ptr<FutureTask<R, F> > task = MakeTask<FutureTask<R, F> >(func);
+		if (PushTask(task, token) == TASK_PUSH_FULL)
+		{
+			task->SetException(boost::copy_exception(InvalidOperationException("ThreadPool task queue is full.")));
+		}
+		return Future<R>(task);
+	}
 };
 
 typedef boost::shared_ptr<ThreadPool> ThreadPoolPtr;
 
+/**
+ * @brief 批量任务构造器
+ *
+ * TaskBatch 先在本地收集任务，调用 Submit() 时通过 ThreadPool::PushTasks 一次性提交。
+ * 析构时会自动提交尚未提交的任务。
+ */
+class TaskBatch
+{
+public:
+	/**
+	 * @brief 构造函数
+	 *
+	 * @param[in] pool 提交任务的线程池
+	 * @param[in] reserve 预留的任务数量
+	 */
+	explicit TaskBatch(ThreadPoolPtr pool, size_t reserve = 0) : m_pool(pool)
+	{
+		m_tasks.reserve(reserve);
+	}
+
+	~TaskBatch()
+	{
+		Submit();
+	}
+
+	/**
+	 * @brief 向批次中添加任务
+	 */
+	void Add(ThreadTaskPtr task)
+	{
+		m_tasks.push_back(task);
+	}
+
+	/**
+	 * @brief 获取批次中尚未提交的任务数量
+	 */
+	size_t Size() const
+	{
+		return m_tasks.size();
+	}
+
+	/**
+	 * @brief 提交批次中的所有任务并清空批次
+	 */
+	void Submit()
+	{
+		if (m_tasks.empty())
+		{
+			return;
+		}
+		m_pool->PushTasks(m_tasks);
+		m_tasks.clear();
+	}
+
+private:
+	TaskBatch(const TaskBatch&);
+	TaskBatch& operator=(const TaskBatch&);
+
+	ThreadPoolPtr m_pool;
+
+	std::vector<ThreadTaskPtr> m_tasks;
+};
+
+const int POOL_SCHED_SHARED_QUEUE  = 0;  /**< 所有线程从同一个全局队列中获取任务 */
+const int POOL_SCHED_WORK_STEALING = 1;  /**< 每个线程拥有本地队列，空闲时窃取其它线程的任务 */
+
+const int POOL_OVERFLOW_BLOCK       = 0;  /**< 队列已满时阻塞提交线程，直到队列有空间     */
+const int POOL_OVERFLOW_FAIL        = 1;  /**< 队列已满时拒绝任务，返回 TASK_PUSH_FULL     */
+const int POOL_OVERFLOW_DROP_OLDEST = 2;  /**< 队列已满时丢弃队列中最早的低优先级任务     */
+const int POOL_OVERFLOW_CALLER_RUNS = 3;  /**< 队列已满时在提交线程中直接执行任务         */
+
+/**
+ * @brief 线程池的创建选项
+ */
+struct LIB_SDK ThreadPoolOptions
+{
+	ThreadPoolOptions();
+
+	/**
+	 * @brief 线程池的大小
+	 */
+	int thread_num;
+
+	/**
+	 * @brief 任务调度方式
+	 * @note 可选的调度方式如下：
+	 * - POOL_SCHED_SHARED_QUEUE  = 0： 共享队列，任务按提交顺序执行（默认）
+	 * - POOL_SCHED_WORK_STEALING = 1： 工作窃取，线程池内部线程提交的任务进入本线程的本地队列，
+	 *                                  本地按后进先出执行，空闲线程按先进先出从其它线程窃取
+	 */
+	int scheduler;
+
+	/**
+	 * @brief 是否将线程绑定到 CPU 核心上，默认为 false
+	 * @note 绑定后第 i 个线程固定运行在 cpu_ids[i % cpu_ids.size()] 上，位于同一 NUMA 节点的线程
+	 *       共享该节点的任务队列，优先执行本节点的任务，空闲时才获取其它节点的任务。
+	 */
+	bool cpu_affinity;
+
+	/**
+	 * @brief 绑定的 CPU 核心编号列表
+	 * @note 为空时使用 ExecutionContext::GetCurrent().rlimit_cpu 中的 resource_id，
+	 *       仍为空时使用全部 CPU 核心。
+	 */
+	std::vector<int> cpu_ids;
+
+	/**
+	 * @brief 是否根据负载自动调整线程数量，默认为 false
+	 * @note 开启后线程数量在 [min_thread_num, max_thread_num] 之间变化：任务的排队时间超过
+	 *       target_wait_us 且没有空闲线程时增加一个线程，线程连续空闲 idle_linger_ms 后退出。
+	 *       thread_num 作为初始线程数量。
+	 */
+	bool auto_scale;
+
+	/**
+	 * @brief 自动调整时的最少线程数量，默认为 1
+	 */
+	int min_thread_num;
+
+	/**
+	 * @brief 自动调整时的最多线程数量
+	 * @note 默认为 0，表示按 ExecutionContext::GetCurrent() 计算：rlimit_cpu 限定了 CPU 数量时使用该数量，
+	 *       否则使用硬件线程数。
+	 */
+	int max_thread_num;
+
+	/**
+	 * @brief 自动调整时任务的目标排队时间（微秒），默认为 1000
+	 */
+	long long target_wait_us;
+
+	/**
+	 * @brief 自动调整时空闲线程退出前的等待时间（毫秒），默认为 30000
+	 */
+	long long idle_linger_ms;
+
+	/**
+	 * @brief 全局队列的容量，默认为 0，表示不限制
+	 * @note 只限制线程池外部线程提交的任务。线程池内部线程提交的任务不受容量限制，
+	 *       避免所有线程相互等待队列空间而死锁。
+	 */
+	size_t queue_capacity;
+
+	/**
+	 * @brief 队列已满时的溢出策略，默认为 POOL_OVERFLOW_BLOCK
+	 * @note 可选的策略如下：
+	 * - POOL_OVERFLOW_BLOCK       = 0： 阻塞提交线程，线程池终止时放弃等待并返回 TASK_PUSH_FULL
+	 * - POOL_OVERFLOW_FAIL        = 1： 立即返回 TASK_PUSH_FULL
+	 * - POOL_OVERFLOW_DROP_OLDEST = 2： 丢弃队列中最早提交的低优先级任务，为新任务腾出空间。只丢弃 TASK_PRIORITY_LOW
+	 *                                   且没有截止时间的任务；队列中没有这样的任务时按 POOL_OVERFLOW_BLOCK 等待
+	 * - POOL_OVERFLOW_CALLER_RUNS = 3： 在提交线程中执行任务，返回 TASK_PUSH_CALLER_RUNS
+	 */
+	int overflow_policy;
+
+	/**
+	 * @brief 线程空闲时挂起前的自旋次数，默认为 0
+	 * @note 线程在队列为空时依次自旋 idle_spin_count 次、让出 CPU idle_yield_count 次，期间持续检查队列，
+	 *       仍没有任务时才挂起等待。自旋期间提交的任务无需唤醒线程，可显著降低延迟敏感任务的启动延迟，
+	 *       代价是空闲时额外的 CPU 占用。两者都为 0 时线程直接挂起。
+	 */
+	int idle_spin_count;
+
+	/**
+	 * @brief 线程空闲时自旋结束后、挂起前让出 CPU 的次数，默认为 0
+	 */
+	int idle_yield_count;
+
+	/**
+	 * @brief 每个线程保留的任务跟踪记录数，默认为 0 表示不跟踪
+	 * @note 开启后线程池内部线程记录每次 Execute() 的开始、结束时间和任务类型，写入本线程的缓冲区，
+	 *       写满后覆盖最早的记录。通过 ThreadPool::DumpTrace() 导出。
+	 */
+	size_t trace_buffer_size;
+
+	/**
+	 * @brief 是否统计任务的排队时间和执行时间，默认为 true
+	 * @note 关闭后提交、取出和执行任务时不再读取时钟：ThreadPoolStats 的 wait_histogram、exec_histogram、
+	 *       busy_us 以及 QueueWaitStats 的 total_wait_us、max_wait_us 保持为 0，任务数、队列长度、
+	 *       截止时间超时等计数仍然有效。开启 auto_scale 或 trace_buffer_size 时相应的时间仍会记录。
+	 */
+	bool collect_timing;
+};
+
 /**
  * @brief 线程池创建的对外统一接口
  *   
@@ -58,6 +493,59 @@ typedef boost::shared_ptr<ThreadPool> ThreadPoolPtr;
  */
 LIB_SDK ThreadPoolPtr CreateThreadPool(int threadNum);
 
+/**
+ * @brief 按指定选项创建线程池
+ *   
+ * @param[in] options 线程池的创建选项
+ *
+ * @return 返回线程池对象
+ */
+LIB_SDK ThreadPoolPtr CreateThreadPool(const ThreadPoolOptions& options);
+
+/**
+ * @brief 获取进程内默认的线程池
+ *
+ * @return 返回默认线程池对象
+ * @note 默认线程池在第一次调用时按 ExecutionContext::GetCurrent() 创建：非多线程环境下只有
+ *       一个线程，rlimit_cpu 限定了 CPU 数量时使用该数量，否则使用硬件线程数；调度方式为工作窃取。
+ *       rlimit_cpu 列出了 CPU 核心编号时，线程绑定到这些核心上。
+ */
+LIB_SDK ThreadPoolPtr GetDefaultThreadPool();
+
+const int TASK_KIND_CPU = 0;  /**< 计算型任务，在默认线程池中执行           */
+const int TASK_KIND_IO  = 1;  /**< 阻塞 I/O 任务，在 I/O 线程池中执行        */
+
+/**
+ * @brief I/O 线程池相对计算线程数的超额倍数。I/O 线程大部分时间阻塞等待，不占用 CPU
+ */
+const int IO_THREADS_PER_CPU = 4;
+
+/**
+ * @brief 获取进程内的 I/O 线程池
+ *
+ * @return 返回 I/O 线程池对象
+ * @note 阻塞的文件、网络读写应提交到 I/O 线程池，避免占用计算线程。I/O 线程池在第一次调用时创建，
+ *       线程数为计算线程数的 IO_THREADS_PER_CPU 倍，调度方式为共享队列，线程不绑定 CPU。
+ *       ExecutionContext::GetCurrent().io_thread_allowed 为 false 时不创建独立的线程，返回默认线程池。
+ */
+LIB_SDK ThreadPoolPtr GetIOThreadPool();
+
+/**
+ * @brief 按任务类型获取执行任务的线程池
+ *
+ * @param[in] kind 任务类型（TASK_KIND_CPU 或 TASK_KIND_IO）
+ *
+ * @return TASK_KIND_IO 返回 GetIOThreadPool()，其它类型返回 GetDefaultThreadPool()
+ */
+LIB_SDK ThreadPoolPtr GetThreadPool(int kind);
+
+/**
+ * @brief 获取当前线程所在的 NUMA 节点
+ *
+ * @return NUMA 节点编号，无法获取时返回 0
+ */
+LIB_SDK int GetCurrentNumaNode();
+
 }
 
 #endif
\ No newline at end of file
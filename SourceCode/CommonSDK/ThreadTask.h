@@ -2,6 +2,7 @@
 #define _FM_SDK_THREADTASK_H_
 
 #include "SystemExport.h"
+#include "TaskAllocator.h"
 
 namespace fm{
 
@@ -16,10 +17,47 @@ public:
 	 * @brief 线程任务执行函数
      */
 	virtual void Execute() = 0;
+
+	/**
+	 * @brief 任务在执行前被取消时调用，例如关联的取消令牌被取消或线程池被终止时从队列中丢弃。
+	 *        默认不做任何处理，等待任务完成的派生类应在此通知等待者
+     */
+	virtual void Cancel() { }
 };
 
 typedef boost::shared_ptr<ThreadTask> ThreadTaskPtr;
 
+/**
+ * @brief 将无参数的可调用对象包装为线程任务
+ */
+template<typename F>
+class FunctionTask : public ThreadTask
+{
+public:
+	explicit FunctionTask(const F& func) : m_func(func) { }
+
+	void Execute()
+	{
+		m_func();
+	}
+
+private:
+	F m_func;
+};
+
+/**
+ * @brief 创建执行指定可调用对象的线程任务，任务对象从任务内存池中分配
+ *
+ * @param[in] func 无参数的可调用对象（函数、函数对象或 lambda）
+ *
+ * @return 返回线程任务对象
+ */
+template<typename F>
+ThreadTaskPtr MakeFunctionTask(F func)
+{
+	return MakeTask<FunctionTask<F> >(func);
+}
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,367 @@
+﻿#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+#include "TimerService.h"
+#include "Exception.h"
+
+namespace fm {
+
+// 时间轮共四层：第一层 256 个槽，每个槽一个节拍；其余三层各 64 个槽，每个槽覆盖上一层一整圈
+const int    WHEEL_ROOT_BITS  = 8;
+const int    WHEEL_LEVEL_BITS = 6;
+const int    WHEEL_LEVELS     = 3;
+const size_t WHEEL_ROOT_SIZE  = size_t(1) << WHEEL_ROOT_BITS;
+const size_t WHEEL_LEVEL_SIZE = size_t(1) << WHEEL_LEVEL_BITS;
+const unsigned long long WHEEL_ROOT_MASK  = WHEEL_ROOT_SIZE - 1;
+const unsigned long long WHEEL_LEVEL_MASK = WHEEL_LEVEL_SIZE - 1;
+
+// 时间轮能直接表示的最大节拍数，更远的定时器先放在最高层，逐层下移时再按实际到期时间重新放置
+const unsigned long long WHEEL_MAX_TICKS = (1ULL << (WHEEL_ROOT_BITS + WHEEL_LEVELS * WHEEL_LEVEL_BITS)) - 1;
+
+// 定时器节点，以侵入式双向链表挂在时间轮的槽上，取消时可直接摘除
+struct TimerEntry
+{
+	TimerEntry() : prev(NULL), next(NULL), expiry(0), period(0) { }
+
+	TimerEntry* prev;
+	TimerEntry* next;
+
+	// 到期节拍和周期节拍数，周期为 0 表示一次性定时器
+	unsigned long long expiry;
+	unsigned long long period;
+
+	ThreadTaskPtr task;
+
+	// 挂在时间轮上时持有自身的引用，摘除时释放
+	TimerHandle self;
+};
+
+typedef boost::chrono::steady_clock TimerClock;
+
+class TimerServiceImpl : public TimerService
+{
+public:
+	TimerServiceImpl(ThreadPoolPtr pool, int tick_ms)
+		: m_pool(pool), m_tickMs(tick_ms > 0 ? tick_ms : 1), m_currentTick(0),
+		  m_pendingCount(0), m_stop(false), m_baseTime(TimerClock::now())
+	{
+		for (size_t i = 0; i < WHEEL_ROOT_SIZE; i++)
+			InitSlot(&m_root[i]);
+		for (int level = 0; level < WHEEL_LEVELS; level++)
+		{
+			for (size_t i = 0; i < WHEEL_LEVEL_SIZE; i++)
+				InitSlot(&m_levels[level][i]);
+		}
+	}
+
+	~TimerServiceImpl()
+	{
+		Shutdown();
+	}
+
+	void Start()
+	{
+		m_thread.reset(new boost::thread(boost::bind(&TimerServiceImpl::TickThread, this)));
+	}
+
+	TimerHandle Schedule(ThreadTaskPtr task, long long delay_ms)
+	{
+		return AddTimer(task, delay_ms, 0);
+	}
+
+	TimerHandle SchedulePeriodic(ThreadTaskPtr task, long long delay_ms, long long period_ms)
+	{
+		if (period_ms <= 0)
+			THROW(ArgumentException, "Timer period must be positive: "<<period_ms);
+		return AddTimer(task, delay_ms, period_ms);
+	}
+
+	bool Cancel(const TimerHandle& handle)
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		if (!handle || handle->next == NULL)
+			return false;
+
+		Unlink(handle.get());
+		handle->self.reset();
+		m_pendingCount--;
+		return true;
+	}
+
+	size_t GetPendingCount() const
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		return m_pendingCount;
+	}
+
+	void Shutdown()
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			m_stop = true;
+			m_condition.notify_all();
+		}
+		if (m_thread)
+		{
+			m_thread->join();
+			m_thread.reset();
+		}
+
+		// 释放所有未到期的定时器
+		std::vector<TimerHandle> entries;
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		for (size_t i = 0; i < WHEEL_ROOT_SIZE; i++)
+			DetachSlot(&m_root[i], entries);
+		for (int level = 0; level < WHEEL_LEVELS; level++)
+		{
+			for (size_t i = 0; i < WHEEL_LEVEL_SIZE; i++)
+				DetachSlot(&m_levels[level][i], entries);
+		}
+		m_pendingCount = 0;
+	}
+
+private:
+	TimerHandle AddTimer(ThreadTaskPtr task, long long delay_ms, long long period_ms)
+	{
+		if (!task)
+			THROW(NullPointerException, "Timer task is null.");
+
+		TimerHandle handle(new TimerEntry());
+		handle->task   = task;
+		handle->period = (unsigned long long)((period_ms + m_tickMs - 1) / m_tickMs);
+
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		if (m_stop)
+			THROW(InvalidOperationException, "TimerService has been shut down.");
+
+		// 时间轮为空时直接把当前节拍移动到当前时刻，避免节拍线程补走空闲期间的节拍
+		unsigned long long now_tick = NowTick();
+		if (m_pendingCount == 0 && now_tick > m_currentTick)
+			m_currentTick = now_tick;
+
+		// 当前时刻向上取整到节拍，保证实际延迟不小于 delay_ms
+		unsigned long long delay_ticks = delay_ms > 0 ? (unsigned long long)((delay_ms + m_tickMs - 1) / m_tickMs) : 0;
+		handle->expiry = std::max(NowTickCeil(), m_currentTick) + delay_ticks;
+		handle->self   = handle;
+		Place(handle.get());
+		if (m_pendingCount++ == 0)
+			m_condition.notify_all();
+		return handle;
+	}
+
+	unsigned long long NowTick() const
+	{
+		long long elapsed = boost::chrono::duration_cast<boost::chrono::milliseconds>(TimerClock::now() - m_baseTime).count();
+		return (unsigned long long)(elapsed / m_tickMs);
+	}
+
+	// 当前时刻之后（含）的第一个节拍
+	unsigned long long NowTickCeil() const
+	{
+		long long elapsed = boost::chrono::duration_cast<boost::chrono::microseconds>(TimerClock::now() - m_baseTime).count();
+		long long tick_us = (long long)m_tickMs * 1000;
+		return (unsigned long long)((elapsed + tick_us - 1) / tick_us);
+	}
+
+	// 按到期节拍把定时器放入对应层的槽中
+	void Place(TimerEntry* entry)
+	{
+		unsigned long long expiry = entry->expiry;
+		unsigned long long delta  = expiry - m_currentTick;
+
+		TimerEntry* slot;
+		if (expiry < m_currentTick)
+		{
+			// 已经到期的定时器放入即将处理的槽
+			slot = &m_root[m_currentTick & WHEEL_ROOT_MASK];
+		}
+		else if (delta < WHEEL_ROOT_SIZE)
+		{
+			slot = &m_root[expiry & WHEEL_ROOT_MASK];
+		}
+		else
+		{
+			if (delta > WHEEL_MAX_TICKS)
+				expiry = m_currentTick + WHEEL_MAX_TICKS;
+
+			int level = 0;
+			while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_ROOT_BITS + (level + 1) * WHEEL_LEVEL_BITS)))
+				level++;
+			slot = &m_levels[level][(expiry >> (WHEEL_ROOT_BITS + level * WHEEL_LEVEL_BITS)) & WHEEL_LEVEL_MASK];
+		}
+		Link(entry, slot);
+	}
+
+	// 处理当前节拍：必要时把上层槽中的定时器下移，然后取出本节拍到期的任务
+	void RunTick(std::vector<ThreadTaskPtr>& due)
+	{
+		size_t index = size_t(m_currentTick & WHEEL_ROOT_MASK);
+		if (index == 0)
+		{
+			for (int level = 0; level < WHEEL_LEVELS; level++)
+			{
+				if (Cascade(level) != 0)
+					break;
+			}
+		}
+		m_currentTick++;
+
+		std::vector<TimerHandle> entries;
+		DetachSlot(&m_root[index], entries);
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			TimerEntry* entry = entries[i].get();
+			if (entry->expiry >= m_currentTick)
+			{
+				// 超出时间轮范围的定时器被提前下移，按实际到期时间重新放置
+				entry->self = entries[i];
+				Place(entry);
+				continue;
+			}
+
+			due.push_back(entry->task);
+			if (entry->period != 0)
+			{
+				entry->expiry += entry->period;
+				entry->self = entries[i];
+				Place(entry);
+			}
+			else
+			{
+				m_pendingCount--;
+			}
+		}
+	}
+
+	// 把指定层当前槽中的定时器重新放置到下层，返回该槽的索引
+	size_t Cascade(int level)
+	{
+		size_t index = size_t((m_currentTick >> (WHEEL_ROOT_BITS + level * WHEEL_LEVEL_BITS)) & WHEEL_LEVEL_MASK);
+
+		std::vector<TimerHandle> entries;
+		DetachSlot(&m_levels[level][index], entries);
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			entries[i]->self = entries[i];
+			Place(entries[i].get());
+		}
+		return index;
+	}
+
+	void TickThread()
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		while (!m_stop)
+		{
+			if (m_pendingCount == 0)
+			{
+				m_condition.wait(lock);
+				continue;
+			}
+
+			unsigned long long now_tick = NowTick();
+			if (m_currentTick > now_tick)
+			{
+				m_condition.wait_until(lock, m_baseTime + boost::chrono::milliseconds(m_currentTick * m_tickMs));
+				continue;
+			}
+
+			std::vector<ThreadTaskPtr> due;
+			while (m_currentTick <= now_tick && m_pendingCount != 0)
+				RunTick(due);
+			if (m_pendingCount == 0)
+				m_currentTick = now_tick + 1;
+
+			// 在锁外提交任务，避免线程池入队阻塞定时器的插入和取消。
+			// 有界线程池拒绝任务时直接在定时线程中执行
+			lock.unlock();
+			for (size_t i = 0; i < due.size(); i++)
+			{
+				if (m_pool->PushTask(due[i]) == TASK_PUSH_FULL)
+					due[i]->Execute();
+			}
+			lock.lock();
+		}
+	}
+
+	static void InitSlot(TimerEntry* slot)
+	{
+		slot->prev = slot;
+		slot->next = slot;
+	}
+
+	static void Link(TimerEntry* entry, TimerEntry* slot)
+	{
+		entry->prev = slot->prev;
+		entry->next = slot;
+		slot->prev->next = entry;
+		slot->prev = entry;
+	}
+
+	static void Unlink(TimerEntry* entry)
+	{
+		entry->prev->next = entry->next;
+		entry->next->prev = entry->prev;
+		entry->prev = NULL;
+		entry->next = NULL;
+	}
+
+	// 摘下槽中的所有定时器，定时器的引用转移到 entries 中
+	static void DetachSlot(TimerEntry* slot, std::vector<TimerHandle>& entries)
+	{
+		while (slot->next != slot)
+		{
+			TimerEntry* entry = slot->next;
+			Unlink(entry);
+			entries.push_back(TimerHandle());
+			entries.back().swap(entry->self);
+		}
+	}
+
+	ThreadPoolPtr m_pool;
+
+	int m_tickMs;
+
+	unsigned long long m_currentTick;
+
+	size_t m_pendingCount;
+
+	bool m_stop;
+
+	TimerClock::time_point m_baseTime;
+
+	TimerEntry m_root[WHEEL_ROOT_SIZE];
+
+	TimerEntry m_levels[WHEEL_LEVELS][WHEEL_LEVEL_SIZE];
+
+	mutable boost::mutex m_mutex;
+
+	boost::condition_variable m_condition;
+
+	boost::shared_ptr<boost::thread> m_thread;
+};
+
+LIB_SDK TimerServicePtr CreateTimerService(ThreadPoolPtr pool, int tick_ms)
+{
+	if (!pool)
+		THROW(NullPointerException, "TimerService requires a thread pool.");
+
+	boost::shared_ptr<TimerServiceImpl> service(new TimerServiceImpl(pool, tick_ms));
+	service->Start();
+	return service;
+}
+
+static TimerServicePtr default_timer_service;
+static boost::once_flag default_timer_service_once = BOOST_ONCE_INIT;
+
+static void CreateDefaultTimerService()
+{
+	default_timer_service = CreateTimerService(GetDefaultThreadPool());
+}
+
+LIB_SDK TimerServicePtr GetDefaultTimerService()
+{
+	boost::call_once(&CreateDefaultTimerService, default_timer_service_once);
+	return default_timer_service;
+}
+
+}
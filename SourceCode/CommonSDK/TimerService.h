@@ -0,0 +1,89 @@
+﻿#ifndef _FM_SDK_TIMER_SERVICE_H_
+#define _FM_SDK_TIMER_SERVICE_H_
+
+#include "SystemExport.h"
+#include "ThreadTask.h"
+#include "ThreadPool.h"
+
+namespace fm {
+
+struct TimerEntry;
+
+typedef boost::shared_ptr<TimerEntry> TimerHandle;
+
+/**
+ * @brief 定时任务服务。
+ *
+ * TimerService 在到期时把线程任务提交到指定的线程池中执行，支持延迟执行和周期执行。
+ * 定时器由分层时间轮管理，插入和取消的时间复杂度均为 O(1)，可同时维护数万个定时器
+ * （如每个连接的超时）。时间轮由一个内部线程按固定的节拍推进，没有定时器时该线程挂起。
+ * @note 定时精度为一个节拍，任务最早在到期时刻之后的下一个节拍被提交。
+ */
+class LIB_SDK TimerService
+{
+public:
+	virtual ~TimerService() { }
+
+	/**
+	 * @brief 延迟执行任务。
+	 *
+	 * @param task 到期时提交到线程池的任务。
+	 * @param delay_ms 延迟时间（毫秒）。
+	 * @return 定时器句柄，可用于取消。
+	 */
+	virtual TimerHandle Schedule(ThreadTaskPtr task, long long delay_ms) = 0;
+
+	/**
+	 * @brief 周期执行任务。
+	 *
+	 * @param task 每次到期时提交到线程池的任务。
+	 * @param delay_ms 第一次执行前的延迟时间（毫秒）。
+	 * @param period_ms 执行周期（毫秒，必须大于 0）。
+	 * @return 定时器句柄，可用于取消。
+	 * @note 周期按固定频率计算，与任务的执行时间无关；任务执行时间超过周期时，同一任务可能并发执行。
+	 */
+	virtual TimerHandle SchedulePeriodic(ThreadTaskPtr task, long long delay_ms, long long period_ms) = 0;
+
+	/**
+	 * @brief 取消定时器。
+	 *
+	 * @param handle 定时器句柄。
+	 * @return 定时器尚未到期（或为周期定时器）并被成功取消时返回 true。
+	 * @note 已经提交到线程池的任务不会被取消。
+	 */
+	virtual bool Cancel(const TimerHandle& handle) = 0;
+
+	/**
+	 * @brief 获取尚未到期的定时器数量。
+	 */
+	virtual size_t GetPendingCount() const = 0;
+
+	/**
+	 * @brief 停止定时服务，丢弃所有尚未到期的定时器。
+	 */
+	virtual void Shutdown() = 0;
+};
+
+typedef boost::shared_ptr<TimerService> TimerServicePtr;
+
+/**
+ * @brief 创建定时任务服务
+ *
+ * @param[in] pool 执行到期任务的线程池
+ * @param[in] tick_ms 时间轮的节拍（毫秒），即定时精度
+ *
+ * @return 返回定时服务对象
+ */
+LIB_SDK TimerServicePtr CreateTimerService(ThreadPoolPtr pool, int tick_ms = 10);
+
+/**
+ * @brief 获取进程内默认的定时服务
+ *
+ * @return 返回默认定时服务对象
+ * @note 默认定时服务在第一次调用时创建，到期任务提交到 GetDefaultThreadPool() 中执行。
+ */
+LIB_SDK TimerServicePtr GetDefaultTimerService();
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+﻿// 日志吞吐量：单线程连续输出 LOG_INFO，统计每条日志的耗时和堆内存分配次数（替换全局 operator new 计数）。
+//
+// 编译（Linux）：
+//   g++ -O2 -I../CommonSDK log_throughput.cpp ../CommonSDK/*.cpp -o log_throughput \
+//       -lboost_thread -lboost_chrono -lboost_system -lboost_date_time -lboost_filesystem -lboost_atomic -luuid -lpthread
+// 运行：./log_throughput [sync|async|listener，默认 sync] [日志目录，默认当前目录]
+//   sync      同步写入日志文件
+//   async     LOG_ASYNC，由后台线程写入日志文件
+//   listener  LOG_ASYNC，并安装一个只统计长度的侦听器
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include "CommonSDK.h"
+
+#if __cplusplus >= 201103L
+#define BENCH_NOEXCEPT noexcept
+#else
+#define BENCH_NOEXCEPT throw()
+#endif
+
+using namespace fm;
+
+typedef boost::chrono::steady_clock Clock;
+
+static boost::atomic<long long> g_allocations(0);
+
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, boost::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) BENCH_NOEXCEPT
+{
+	free(p);
+}
+
+class LengthListener : public LoggingListener
+{
+public:
+	LengthListener() : m_total(0) { }
+
+	void Log(const char* name, int severity, const std::string& msg)
+	{
+		m_total += msg.size();
+	}
+
+	void Log(const char* name, int severity, const char* text, size_t size)
+	{
+		m_total += size;
+	}
+
+private:
+	size_t m_total;
+};
+
+int main(int argc, char** argv)
+{
+	const char* mode = argc > 1 ? argv[1] : "sync";
+	const char* path = argc > 2 ? argv[2] : ".";
+	const int COUNT = 200000;
+
+	int config = strcmp(mode, "sync") == 0 ? 0 : LOG_ASYNC;
+	Logging::Init("log_throughput", path, config);
+	LengthListener listener;
+	if (strcmp(mode, "listener") == 0)
+	{
+		Logging::InstallListener(&listener);
+	}
+
+	// 预热线程私有缓冲区和异步缓冲区
+	for (int i = 0; i < 1000; i++)
+	{
+		LOG_INFO("warm up " << i);
+	}
+
+	long long allocations = g_allocations.load();
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < COUNT; i++)
+	{
+		LOG_INFO("message " << i << " value " << 3.25 << " some payload text here");
+	}
+	double ns = boost::chrono::duration_cast<boost::chrono::nanoseconds>(Clock::now() - start).count() / double(COUNT);
+	allocations = g_allocations.load() - allocations;
+
+	Logging::Shutdown();
+	Logging::RemoveListener(&listener);
+	std::cout << mode << ": " << ns << " ns/message, " << double(allocations) / COUNT << " allocations/message" << std::endl;
+	return 0;
+}
@@ -0,0 +1,83 @@
+﻿// 日志时间戳的开销：对照原来每条日志调用一次的 Time::Now().FormatString()，
+// 以及三种时间戳精度下同步输出一条 LOG_INFO 的耗时和堆内存分配次数（替换全局 operator new 计数）。
+//
+// 编译（Linux）：
+//   g++ -O2 -I../CommonSDK log_timestamp.cpp ../CommonSDK/*.cpp -o log_timestamp \
+//       -lboost_thread -lboost_chrono -lboost_system -lboost_date_time -lboost_filesystem -lboost_atomic -luuid -lpthread
+// 运行：./log_timestamp [日志目录，默认当前目录]
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include "CommonSDK.h"
+
+#if __cplusplus >= 201103L
+#define BENCH_NOEXCEPT noexcept
+#else
+#define BENCH_NOEXCEPT throw()
+#endif
+
+using namespace fm;
+
+typedef boost::chrono::steady_clock Clock;
+
+static boost::atomic<long long> g_allocations(0);
+
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, boost::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) BENCH_NOEXCEPT
+{
+	free(p);
+}
+
+static void Report(const char* name, Clock::time_point start, long long allocations, int count)
+{
+	double ns = boost::chrono::duration_cast<boost::chrono::nanoseconds>(Clock::now() - start).count() / double(count);
+	std::cout << name << ": " << ns << " ns/call, "
+		<< double(g_allocations.load() - allocations) / count << " allocations/call" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = argc > 1 ? argv[1] : ".";
+	const int COUNT = 200000;
+
+	size_t length = 0;
+	long long allocations = g_allocations.load();
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < COUNT; i++)
+	{
+		length += Time::Now().FormatString().size();
+	}
+	Report("Time::Now().FormatString()", start, allocations, COUNT);
+
+	Logging::Init("log_timestamp", path, 0);
+	const int precisions[] = { LOG_TIME_SECOND, LOG_TIME_MILLISECOND, LOG_TIME_MICROSECOND };
+	const char* names[] = { "LOG_INFO, LOG_TIME_SECOND", "LOG_INFO, LOG_TIME_MILLISECOND", "LOG_INFO, LOG_TIME_MICROSECOND" };
+	for (int p = 0; p < 3; p++)
+	{
+		Logging::TimestampPrecision() = precisions[p];
+		for (int i = 0; i < 1000; i++)
+		{
+			LOG_INFO("warm up " << i);
+		}
+
+		allocations = g_allocations.load();
+		start = Clock::now();
+		for (int i = 0; i < COUNT; i++)
+		{
+			LOG_INFO("message " << i);
+		}
+		Report(names[p], start, allocations, COUNT);
+	}
+	Logging::Shutdown();
+	return length != 0 ? 0 : 1;
+}
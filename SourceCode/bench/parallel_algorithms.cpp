@@ -0,0 +1,114 @@
+﻿// 并行算法与单线程循环、逐个元素 PushTask 的对比：对 4M 个元素计算平方根，
+// 分别统计 1、2、4、8 个线程时每个元素的平均耗时。
+//
+// 编译（Linux）：
+//   g++ -O2 -I../CommonSDK parallel_algorithms.cpp ../CommonSDK/*.cpp -o parallel_algorithms \
+//       -lboost_thread -lboost_chrono -lboost_system -lboost_date_time -lboost_filesystem -lboost_atomic -luuid -lpthread
+// 运行：./parallel_algorithms
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+#include "CommonSDK.h"
+
+using namespace fm;
+
+typedef boost::chrono::steady_clock Clock;
+
+static const int ELEMENT_COUNT = 4000000;
+
+// 逐个元素提交任务的元素数，任务开销远大于计算本身，只取一部分元素
+static const int TASK_COUNT = 200000;
+
+static double NsPerElement(Clock::time_point start, size_t count)
+{
+	return boost::chrono::duration_cast<boost::chrono::nanoseconds>(Clock::now() - start).count() / double(count);
+}
+
+struct SqrtBody
+{
+	explicit SqrtBody(std::vector<double>* values) : values(values) { }
+
+	void operator()(int i) const
+	{
+		(*values)[i] = std::sqrt(double(i));
+	}
+
+	std::vector<double>* values;
+};
+
+struct SqrtValue
+{
+	double operator()(int i) const
+	{
+		return std::sqrt(double(i));
+	}
+};
+
+class SqrtTask : public ThreadTask
+{
+public:
+	SqrtTask(std::vector<double>* values, int index, boost::atomic<int>* left) : m_values(values), m_index(index), m_left(left) { }
+
+	void Execute()
+	{
+		(*m_values)[m_index] = std::sqrt(double(m_index));
+		m_left->fetch_sub(1, boost::memory_order_release);
+	}
+
+private:
+	std::vector<double>* m_values;
+	int m_index;
+	boost::atomic<int>* m_left;
+};
+
+int main()
+{
+	Logging::Severity() = SEV_WARNING;
+	std::vector<double> values(ELEMENT_COUNT);
+	SqrtBody body(&values);
+
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < ELEMENT_COUNT; i++)
+	{
+		body(i);
+	}
+	std::cout << "single-threaded loop: " << NsPerElement(start, ELEMENT_COUNT) << " ns/element" << std::endl;
+
+	const int threads[] = { 1, 2, 4, 8 };
+	for (size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); k++)
+	{
+		ThreadPoolPtr pool = CreateThreadPool(threads[k]);
+		std::cout << threads[k] << " threads:" << std::endl;
+
+		start = Clock::now();
+		for (int r = 0; r < 5; r++)
+		{
+			parallel_for(pool, 0, ELEMENT_COUNT, body);
+		}
+		std::cout << "  parallel_for          " << NsPerElement(start, 5 * size_t(ELEMENT_COUNT)) << " ns/element" << std::endl;
+
+		start = Clock::now();
+		double sum = parallel_reduce(pool, 0, ELEMENT_COUNT, 0.0, SqrtValue(), std::plus<double>());
+		std::cout << "  parallel_reduce       " << NsPerElement(start, ELEMENT_COUNT) << " ns/element (sum " << sum << ")" << std::endl;
+
+		boost::atomic<int> left(TASK_COUNT);
+		start = Clock::now();
+		for (int i = 0; i < TASK_COUNT; i++)
+		{
+			pool->PushTask(ThreadTaskPtr(new SqrtTask(&values, i, &left)));
+		}
+		while (left.load(boost::memory_order_acquire) != 0)
+		{
+			boost::this_thread::yield();
+		}
+		std::cout << "  per-element PushTask  " << NsPerElement(start, TASK_COUNT) << " ns/element" << std::endl;
+
+		pool->Terminate();
+		pool->Join();
+	}
+	return 0;
+}
@@ -0,0 +1,155 @@
+﻿// 线程池任务队列吞吐量：T 个提交线程各提交 N/T 个空任务给 T 个工作线程，统计每秒完成的任务数。
+// 对照组是 ThreadPool 原来的实现方式（std::list 队列 + 单个互斥锁和条件变量）。
+//
+// 编译（Linux）：
+//   g++ -O2 -I../CommonSDK queue_throughput.cpp ../CommonSDK/*.cpp -o queue_throughput \
+//       -lboost_thread -lboost_chrono -lboost_system -lboost_date_time -lboost_filesystem -lboost_atomic -luuid -lpthread
+// 运行：./queue_throughput [线程数，默认依次测试 1 ~ 64]
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+#include "CommonSDK.h"
+
+using namespace fm;
+
+typedef boost::chrono::steady_clock Clock;
+
+static const long TASK_COUNT = 400000;
+
+static boost::atomic<long> g_done(0);
+
+class CountTask : public ThreadTask
+{
+public:
+	void Execute()
+	{
+		g_done.fetch_add(1, boost::memory_order_relaxed);
+	}
+};
+
+// 对照组：所有线程竞争同一个互斥锁，每次提交分配一个链表节点
+class ListMutexPool
+{
+public:
+	explicit ListMutexPool(int thread_num) : m_terminate(false)
+	{
+		for (int i = 0; i < thread_num; i++)
+		{
+			m_threads.create_thread(boost::bind(&ListMutexPool::Run, this));
+		}
+	}
+
+	~ListMutexPool()
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			m_terminate = true;
+			m_condition.notify_all();
+		}
+		m_threads.join_all();
+	}
+
+	void PushTask(ThreadTaskPtr task)
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		m_tasks.push_back(task);
+		m_condition.notify_one();
+	}
+
+private:
+	void Run()
+	{
+		while (true)
+		{
+			ThreadTaskPtr task;
+			{
+				boost::unique_lock<boost::mutex> lock(m_mutex);
+				while (m_tasks.empty() && !m_terminate)
+				{
+					m_condition.wait(lock);
+				}
+				if (m_tasks.empty())
+				{
+					return;
+				}
+				task = m_tasks.front();
+				m_tasks.pop_front();
+			}
+			task->Execute();
+		}
+	}
+
+	std::list<ThreadTaskPtr> m_tasks;
+	boost::mutex m_mutex;
+	boost::condition_variable m_condition;
+	bool m_terminate;
+	boost::thread_group m_threads;
+};
+
+template <typename Pool>
+static void Produce(Pool* pool, long count)
+{
+	for (long i = 0; i < count; i++)
+	{
+		pool->PushTask(ThreadTaskPtr(new CountTask()));
+	}
+}
+
+// 返回每秒完成的任务数（百万）
+template <typename Pool>
+static double Measure(Pool* pool, int producers)
+{
+	long per_producer = TASK_COUNT / producers;
+	long total = per_producer * producers;
+	g_done.store(0);
+	Clock::time_point start = Clock::now();
+	boost::thread_group group;
+	for (int i = 0; i < producers; i++)
+	{
+		group.create_thread(boost::bind(&Produce<Pool>, pool, per_producer));
+	}
+	group.join_all();
+	while (g_done.load() < total)
+	{
+		boost::this_thread::yield();
+	}
+	double seconds = boost::chrono::duration_cast<boost::chrono::microseconds>(Clock::now() - start).count() / 1e6;
+	return total / seconds / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+	Logging::Severity() = SEV_WARNING;
+	const int counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+	std::cout << "threads  list+mutex  pool  pool(collect_timing=false)  Mtasks/s" << std::endl;
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+	{
+		int threads = counts[i];
+		if (argc > 1 && threads != atoi(argv[1]))
+		{
+			continue;
+		}
+
+		double baseline = 0;
+		{
+			ListMutexPool pool(threads);
+			baseline = Measure(&pool, threads);
+		}
+
+		double results[2];
+		for (int timing = 1; timing >= 0; timing--)
+		{
+			ThreadPoolOptions options;
+			options.thread_num = threads;
+			options.collect_timing = timing != 0;
+			ThreadPoolPtr pool = CreateThreadPool(options);
+			results[1 - timing] = Measure(pool.get(), threads);
+			pool->Terminate();
+			pool->Join();
+		}
+		std::cout << threads << "  " << baseline << "  " << results[0] << "  " << results[1] << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,124 @@
+﻿// 任务对象的分配开销：单个工作线程执行 1M 个空任务，对照 ThreadTaskPtr(new T)（对象和 shared_ptr
+// 控制块各分配一次）与 MakeTask<T>()（任务内存池中的一个块），以及 MakeFunctionTask 和 Submit，
+// 统计吞吐量和堆内存分配次数（替换全局 operator new 计数）。
+//
+// 编译（Linux）：
+//   g++ -O2 -I../CommonSDK task_allocation.cpp ../CommonSDK/*.cpp -o task_allocation \
+//       -lboost_thread -lboost_chrono -lboost_system -lboost_date_time -lboost_filesystem -lboost_atomic -luuid -lpthread
+// 运行：./task_allocation
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+#include "CommonSDK.h"
+
+#if __cplusplus >= 201103L
+#define BENCH_NOEXCEPT noexcept
+#else
+#define BENCH_NOEXCEPT throw()
+#endif
+
+using namespace fm;
+
+typedef boost::chrono::steady_clock Clock;
+
+static boost::atomic<long long> g_allocations(0);
+
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, boost::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) BENCH_NOEXCEPT
+{
+	free(p);
+}
+
+static const long TASK_COUNT = 1000000;
+
+// 提交线程最多领先工作线程的任务数，避免队列无限增长
+static const long MAX_IN_FLIGHT = 2048;
+
+static boost::atomic<long> g_done(0);
+
+class CountTask : public ThreadTask
+{
+public:
+	void Execute()
+	{
+		g_done.fetch_add(1, boost::memory_order_relaxed);
+	}
+};
+
+struct CountFunc
+{
+	typedef void result_type;
+
+	void operator()() const
+	{
+		g_done.fetch_add(1, boost::memory_order_relaxed);
+	}
+};
+
+enum SubmitKind
+{
+	SUBMIT_NEW,
+	SUBMIT_MAKE_TASK,
+	SUBMIT_FUNCTION_TASK,
+	SUBMIT_FUTURE
+};
+
+static void Run(ThreadPoolPtr pool, SubmitKind kind, const char* name)
+{
+	g_done.store(0);
+	long long allocations = g_allocations.load();
+	Clock::time_point start = Clock::now();
+	for (long i = 0; i < TASK_COUNT; i++)
+	{
+		while (i - g_done.load(boost::memory_order_relaxed) > MAX_IN_FLIGHT)
+		{
+			boost::this_thread::yield();
+		}
+
+		switch (kind)
+		{
+		case SUBMIT_NEW:
+			pool->PushTask(ThreadTaskPtr(new CountTask()));
+			break;
+		case SUBMIT_MAKE_TASK:
+			pool->PushTask(MakeTask<CountTask>());
+			break;
+		case SUBMIT_FUNCTION_TASK:
+			pool->PushTask(MakeFunctionTask(CountFunc()));
+			break;
+		case SUBMIT_FUTURE:
+			pool->Submit(CountFunc());
+			break;
+		}
+	}
+	while (g_done.load() < TASK_COUNT)
+	{
+		boost::this_thread::yield();
+	}
+	double ms = boost::chrono::duration_cast<boost::chrono::microseconds>(Clock::now() - start).count() / 1000.0;
+	std::cout << name << ": " << TASK_COUNT / ms << " tasks/ms, "
+		<< double(g_allocations.load() - allocations) / TASK_COUNT << " allocations/task" << std::endl;
+}
+
+int main()
+{
+	Logging::Severity() = SEV_WARNING;
+	ThreadPoolPtr pool = CreateThreadPool(1);
+	Run(pool, SUBMIT_NEW,           "PushTask(ThreadTaskPtr(new T))");
+	Run(pool, SUBMIT_MAKE_TASK,     "PushTask(MakeTask<T>())");
+	Run(pool, SUBMIT_FUNCTION_TASK, "PushTask(MakeFunctionTask(f))");
+	Run(pool, SUBMIT_FUTURE,        "Submit(f)");
+	pool->Terminate();
+	pool->Join();
+	return 0;
+}
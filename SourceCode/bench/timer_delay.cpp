@@ -0,0 +1,82 @@
+﻿// 检查定时器的实际延迟不小于请求的延迟，并输出延迟误差的分布。
+//
+// 编译（Linux）：
+//   g++ -O2 -I../CommonSDK timer_delay.cpp ../CommonSDK/*.cpp -o timer_delay \
+//       -lboost_thread -lboost_chrono -lboost_system -lboost_date_time -lboost_filesystem -lboost_atomic -luuid -lpthread
+// 运行：./timer_delay [节拍毫秒数，默认 10]
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+#include "CommonSDK.h"
+
+using namespace fm;
+
+typedef boost::chrono::steady_clock Clock;
+
+static long long NowUs()
+{
+	return boost::chrono::duration_cast<boost::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static boost::atomic<long> g_fired(0);
+
+class DelayProbe : public ThreadTask
+{
+public:
+	DelayProbe(long long start_us, long long* actual_us) : m_start(start_us), m_actual(actual_us) { }
+
+	void Execute()
+	{
+		*m_actual = NowUs() - m_start;
+		g_fired.fetch_add(1);
+	}
+
+private:
+	long long  m_start;
+	long long* m_actual;
+};
+
+int main(int argc, char** argv)
+{
+	Logging::Severity() = SEV_WARNING;
+	int tick_ms = argc > 1 ? atoi(argv[1]) : 10;
+	const int COUNT = 400;
+
+	ThreadPoolPtr pool = CreateThreadPool(2);
+	TimerServicePtr timers = CreateTimerService(pool, tick_ms);
+
+	std::vector<long long> delays(COUNT), actual(COUNT, 0);
+	srand(1);
+	for (int i = 0; i < COUNT; i++)
+	{
+		// 在节拍内的随机相位上创建定时器
+		boost::this_thread::sleep_for(boost::chrono::microseconds(rand() % (tick_ms * 1000)));
+		delays[i] = 1 + rand() % (5 * tick_ms);
+		timers->Schedule(ThreadTaskPtr(new DelayProbe(NowUs(), &actual[i])), delays[i]);
+	}
+	while (g_fired.load() < COUNT)
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+
+	int early = 0;
+	std::vector<long long> slack(COUNT);
+	for (int i = 0; i < COUNT; i++)
+	{
+		slack[i] = actual[i] - delays[i] * 1000;
+		if (slack[i] < 0)
+		{
+			early++;
+			std::cout << "early: requested " << delays[i] << " ms, fired after " << actual[i] / 1000.0 << " ms" << std::endl;
+		}
+	}
+	std::sort(slack.begin(), slack.end());
+	std::cout << "tick " << tick_ms << " ms, " << COUNT << " timers: slack min " << slack.front() / 1000.0
+		<< " ms, p50 " << slack[COUNT / 2] / 1000.0 << " ms, max " << slack.back() / 1000.0 << " ms, early " << early << std::endl;
+
+	timers->Shutdown();
+	pool->Terminate();
+	pool->Join();
+	return early == 0 ? 0 : 1;
+}